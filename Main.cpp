@@ -1,10 +1,39 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <unordered_map>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef LIBZSTD
+#include <zstd.h>
+#endif
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#include <immintrin.h>
+#endif
 
 /**
     Returns the number of milliseconds since the given timestamp.
@@ -17,43 +46,198 @@ double since(clock_t start)
     return 1000.*double(clock() - start) / CLOCKS_PER_SEC;
 }
 
+#include "pool.hpp"
+
 #include "intersection.hpp"
 
+#include "store.hpp"
+
+#include "dataset.hpp"
+
+#include "compressed.hpp"
+
 #include "knapsack.hpp"
 
 #include "parse.hpp"
 
+#include "cache.hpp"
+
+#include "server.hpp"
+
 /**
     Program entry point. Reads five lines from stdin, finds an optimal route allocation
-    for the described problem instance and writes it to stdout.
+    for the described problem instance and writes it to stdout. The paths to the regions and routes
+    may name GeoJSON files, which may be compressed with gzip or zstd, or binary datasets made from them
+    by the converter in convert_Main.cpp.
+
+    With the option --linear, an optimal allocation is found without keeping the whole
+    dynamic programming table in memory. Where several allocations are optimal, it may be
+    another one than without the option.
+
+    With the option --epsilon=E, an allocation reaching at least 1-E times the optimal value is found
+    in time polynomial in the number of routes and 1/E, whatever the costs. It is followed by a line
+    BOUND,VALUE,UPPER with the value of the allocation and an upper bound on the optimal value.
+
+    With the option --threads=N, the GeoJSON files are parsed, the intersections are computed and
+    the rows of the dynamic programming table are computed on N threads.
+
+    With the options --frontier and --budgets=B1,B2,..., the table is filled once and answers
+    many budgets: --frontier writes the lines BUDGET,VALUE where the maximum value increases
+    and --budgets writes, for each given budget, a line BUDGET,B followed by its allocation.
+
+    With the option --cache=PATH, the regions intersected by each route are kept in the file PATH,
+    so that later runs on the same GeoJSON files skip the polygons and the intersections.
+
+    With the option --stream, each region is intersected with the routes as soon as it is parsed and
+    then forgotten, so the memory does not grow with the number of regions.
+
+    With the option --serve, the program instead reads the two lines POPULATION_GEOJSON and ROUTE_GEOJSON,
+    keeps their routes, population and intersections in memory and answers queries of three lines
+    TARGET_AGES, BUDGET and ACTIVE_CSV until the input ends, see server::serve.
+
+    With the option --batch=PATH, the program reads the same two lines and answers all queries in the file
+    PATH at once, sharing the work between queries with the same target ages, see server::batch.
 
     If there is some error somewhere in a subroutine,
     the program will immediately exit with return code -1.
 
+    @param argc the number of command line arguments
+    @param argv the command line arguments, see parse::options
     @return 0 meaning success
 */
-int main()
+int main(int argc, char* argv[])
 {
     clock_t total_start = clock();
+    parse::Options options = parse::options(argc, argv);
 
-    std::vector<std::unique_ptr<intersection::Region>> regions;
+    store::Store store;
     std::vector<std::unique_ptr<intersection::Route>> routes;
     double budget;
-    double cost_gcd;
+    double cost_gcd {0.0};
     double min_cost {std::numeric_limits<double>::infinity()};
     std::map<int, int> allocation;
+    intersection::Index index;
+
+    if (options.serve)
+    {
+        pool::Pool workers {options.threads};
+        std::string regions_path = parse::line();
+        std::string routes_path = parse::line();
+        server::report(server::serve(std::cin, std::cout, regions_path, routes_path, &workers));
+        std::clog << "Total runtime is " << since(total_start) << "ms" << std::endl;
+        return 0;
+    }
+
+    if (not options.batch.empty())
+    {
+        pool::Pool workers {options.threads};
+        std::string regions_path = parse::line();
+        std::string routes_path = parse::line();
+        std::ifstream queries {options.batch};
+        if (not queries.is_open())
+        {
+            std::clog << "Could not find the batch file " << options.batch << std::endl;
+            exit(-1);
+        }
+        auto data = server::load(cache::Key{}, regions_path, routes_path, &workers);
+        if (not data) { exit(-1); }
+        size_t groups = server::batch(queries, std::cout, *data, &workers);
+        std::clog << "Answered " << groups << " groups of queries" << std::endl;
+        std::clog << "Total runtime is " << since(total_start) << "ms" << std::endl;
+        return 0;
+    }
 
     std::string age_string = parse::line();
     std::string budget_string = parse::line();
     std::string regions_path = parse::line();
     std::string routes_path = parse::line();
     std::string active_path = parse::line();
-    parse::input(regions, routes, budget, min_cost, cost_gcd,
-        age_string, budget_string, regions_path, routes_path, active_path);
+    pool::Pool workers {options.threads};
+
+    clock_t input_start = clock();
+    if (options.stream)
+    {
+        parse::stream(store, budget, min_cost, cost_gcd,
+            age_string, budget_string, regions_path, routes_path, active_path, &workers);
+    }
+    else if (options.cache.empty())
+    {
+        parse::input(store, budget, min_cost, cost_gcd,
+            age_string, budget_string, regions_path, routes_path, active_path, &index, &workers, true);
+        store::all(store, &index, nullptr, &workers);
+    }
+    else
+    {
+        bool warm = cache::input(options.cache, store, budget, min_cost, cost_gcd,
+            age_string, budget_string, regions_path, routes_path, active_path, &index, &workers);
+        std::clog << (warm ? "Warm" : "Cold") << " start took " << since(input_start) << "ms" << std::endl;
+    }
+    store::items(store, routes);
+
+    if (options.frontier or not options.budgets.empty())
+    {
+        double max_budget = budget;
+        for (auto listed : options.budgets) { max_budget = std::max(max_budget, listed); }
+
+        knapsack::Table table;
+        knapsack::solve(routes, max_budget, cost_gcd, table, &workers);
+
+        // the values of the curve and the listed budgets are written exactly
+        std::cout.precision(std::numeric_limits<double>::max_digits10);
+        if (options.frontier)
+        {
+            std::vector<std::pair<double, double>> curve;
+            knapsack::frontier(table, curve);
+            for (const auto& point : curve)
+            {
+                std::cout << point.first << "," << point.second << "\n";
+            }
+        }
+
+        for (auto listed : options.budgets)
+        {
+            std::map<int, int> listed_allocation;
+            if (listed >= min_cost)
+            {
+                knapsack::allocate(table, routes, knapsack::units(listed, cost_gcd), listed_allocation);
+            }
 
-    intersection::all(regions, routes);
+            std::cout << "BUDGET," << listed << "\n";
+            for (const auto& iter : listed_allocation)
+            {
+                std::cout << iter.first << "," << iter.second << "\n";
+            }
+        }
 
-    knapsack::optimize(routes, budget, min_cost, cost_gcd, allocation);
+        std::clog << "Total runtime is " << since(total_start) << "ms" << std::endl;
+        return 0;
+    }
+
+    if (options.epsilon > 0.0)
+    {
+        double upper_bound;
+        double value = knapsack::approximate(routes, budget, options.epsilon, allocation, upper_bound);
+        for (const auto& iter : allocation)
+        {
+            std::cout << iter.first << "," << iter.second << "\n";
+        }
+        std::cout.precision(std::numeric_limits<double>::max_digits10);
+        std::cout << "BOUND," << value << "," << upper_bound << "\n";
+
+        std::clog << "Total runtime is " << since(total_start) << "ms" << std::endl;
+        return 0;
+    }
+
+    if (options.linear)
+    {
+        knapsack::Memory memory;
+        knapsack::optimize_linear(routes, budget, min_cost, cost_gcd, allocation, memory, &workers);
+        std::clog << "Peak memory of the rows is " << memory.peak << " bytes" << std::endl;
+    }
+    else
+    {
+        knapsack::optimize(routes, budget, min_cost, cost_gcd, allocation, &workers);
+    }
 
     // output our allocation of routes
     for (const auto& iter : allocation)
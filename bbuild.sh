@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ -Wall -Wextra -O2 -std=c++14 -pthread -o bench bench_Main.cpp -lz "$@"
@@ -0,0 +1,1429 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef LIBZSTD
+#include <zstd.h>
+#endif
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#include <immintrin.h>
+#endif
+
+// the number of heap allocations so far, counted by the replaced operator new
+std::atomic<size_t> allocations {0};
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* memory = std::malloc(size)) { return memory; }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept { std::free(memory); }
+
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+/**
+    Returns the number of milliseconds since the given timestamp.
+
+    @param start given timestamp
+    @return time since given timestamp in milliseconds
+*/
+double since(clock_t start)
+{
+    return 1000.*double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+#include "pool.hpp"
+
+#include "intersection.hpp"
+
+#include "store.hpp"
+
+#include "dataset.hpp"
+
+#include "compressed.hpp"
+
+#include "knapsack.hpp"
+
+#include "parse.hpp"
+
+#include "cache.hpp"
+
+#include "server.hpp"
+
+/**
+    Creates routes without geometry whose benefits look like the ones computed by store::all,
+    that is, sums of min(b+1, buses) times some random target numbers.
+
+    @param routes the vector to store the routes
+    @param count the number of routes
+    @param cost_gcd all costs are random multiples of this number
+    @param max_multiple the maximal multiple of cost_gcd for any cost
+    @param seed the seed of the random number generator
+*/
+void synthetic_routes(
+    std::vector<std::unique_ptr<intersection::Route>>& routes,
+    int count,
+    double cost_gcd,
+    int max_multiple,
+    unsigned seed)
+{
+    std::mt19937 generator {seed};
+    std::uniform_int_distribution<int> multiple {1, max_multiple};
+    std::uniform_int_distribution<int> buses {1, 3};
+    std::uniform_real_distribution<double> targets {0.0, 1000.0};
+    for (int r = 0; r < count; ++r)
+    {
+        auto route = std::make_unique<intersection::Route>();
+        route->outputId = r;
+        route->cost = cost_gcd * multiple(generator);
+        for (int s = 0; s < intersection::TIMESLOTS; ++s) { route->buses[s] = buses(generator); }
+        auto maxBuses = std::max({route->buses[0], route->buses[1], route->buses[2]});
+        route->benefits.assign(maxBuses, 0.0);
+        for (int s = 0; s < intersection::TIMESLOTS; ++s)
+        {
+            double slot_targets = targets(generator);
+            for (int b = 0; b < maxBuses; ++b)
+            {
+                route->benefits[b] += std::min(b+1, route->buses[s]) * slot_targets;
+            }
+        }
+        routes.push_back(std::move(route));
+    }
+}
+
+/**
+    Creates square regions forming a mesh with the given number of cells per side, with random targets.
+
+    @param regions the vector to store the regions
+    @param grid the grid to file the regions in
+    @param side the number of cells per side of the mesh
+    @param cell the side length of a cell
+    @param seed the seed of the random number generator
+*/
+void synthetic_mesh(
+    std::vector<std::unique_ptr<intersection::Region>>& regions,
+    intersection::Grid& grid,
+    int side,
+    double cell,
+    unsigned seed)
+{
+    std::mt19937 generator {seed};
+    std::uniform_real_distribution<double> targets {0.0, 100.0};
+    for (int column = 0; column < side; ++column)
+    {
+        for (int row = 0; row < side; ++row)
+        {
+            auto region = std::make_unique<intersection::Region>();
+            region->meshId = column*side + row;
+            for (auto& target : region->targets) { target = targets(generator); }
+            double x = 139.0 + column*cell;
+            double y = 35.0 + row*cell;
+            region->polygon = {{x, y}, {x, y + cell}, {x + cell, y + cell}, {x + cell, y}, {x, y}};
+            intersection::split(region->polygon, region->edges);
+            region->box = {intersection::Point{x, y}, intersection::Point{x + cell, y + cell}};
+            intersection::insert(grid, region->box, regions.size());
+            regions.push_back(std::move(region));
+        }
+    }
+}
+
+/**
+    Creates routes with random-walk polylines inside the given area.
+
+    @param routes the vector to store the routes
+    @param count the number of routes
+    @param points the number of points per route
+    @param step the maximal step length of the random walk
+    @param area the area containing the routes
+    @param seed the seed of the random number generator
+*/
+void synthetic_geometry(
+    std::vector<std::unique_ptr<intersection::Route>>& routes,
+    int count,
+    int points,
+    double step,
+    const intersection::Box& area,
+    unsigned seed)
+{
+    std::mt19937 generator {seed};
+    std::uniform_real_distribution<double> x {area[0][0], area[1][0]};
+    std::uniform_real_distribution<double> y {area[0][1], area[1][1]};
+    std::uniform_real_distribution<double> move {-step, step};
+    std::uniform_int_distribution<int> buses {1, 3};
+    for (int r = 0; r < count; ++r)
+    {
+        auto route = std::make_unique<intersection::Route>();
+        route->outputId = r;
+        route->cost = 800000;
+        for (int s = 0; s < intersection::TIMESLOTS; ++s) { route->buses[s] = buses(generator); }
+        route->polylines.emplace_back();
+        intersection::Point point {x(generator), y(generator)};
+        for (int p = 0; p < points; ++p)
+        {
+            point[0] = std::min(std::max(point[0] + move(generator), area[0][0]), area[1][0]);
+            point[1] = std::min(std::max(point[1] + move(generator), area[0][1]), area[1][1]);
+            route->polylines.back().push_back(point);
+            route->box[0][0] = std::min(route->box[0][0], point[0]);
+            route->box[0][1] = std::min(route->box[0][1], point[1]);
+            route->box[1][0] = std::max(route->box[1][0], point[0]);
+            route->box[1][1] = std::max(route->box[1][1], point[1]);
+        }
+        intersection::bound(route->polylines.back(), route->polyline_boxes, route->chunk_boxes);
+        routes.push_back(std::move(route));
+    }
+}
+
+/**
+    Compares the working memory and running time of the full table and the linear-memory solver.
+
+    @param name the name of the instance
+    @param routes the routes with computed benefits
+    @param budget the total given budget
+    @param min_cost the minimum cost across all routes
+    @param cost_gcd the greatest common divisor of all route costs
+*/
+void compare_memory(
+    const std::string& name,
+    const std::vector<std::unique_ptr<intersection::Route>>& routes,
+    double budget,
+    double min_cost,
+    double cost_gcd)
+{
+    const size_t table_limit = 512u << 20;
+    size_t table_bytes = routes.size() * (knapsack::units(budget, cost_gcd) + 1) * sizeof(double);
+
+    std::cout << name << ": " << routes.size() << " routes, " << knapsack::units(budget, cost_gcd) + 1 << " budget units\n";
+    std::map<int, int> allocation;
+    double value = 0.0;
+    if (table_bytes <= table_limit)
+    {
+        clock_t start = clock();
+        value = knapsack::optimize(routes, budget, min_cost, cost_gcd, allocation);
+        std::cout << "    table:  peak " << table_bytes << " bytes, " << since(start) << "ms\n";
+    }
+    else
+    {
+        std::cout << "    table:  peak " << table_bytes << " bytes (too big, not run)\n";
+    }
+
+    knapsack::Memory memory;
+    std::map<int, int> linear_allocation;
+    clock_t start = clock();
+    double linear_value = knapsack::optimize_linear(routes, budget, min_cost, cost_gcd, linear_allocation, memory);
+    std::cout << "    linear: peak " << memory.peak << " bytes, " << since(start) << "ms";
+    if (table_bytes <= table_limit)
+    {
+        std::cout << (linear_value != value ? ", DIFFERENT value" : linear_allocation == allocation ? ", same allocation" : ", tied allocation");
+    }
+    std::cout << std::endl;
+}
+
+/**
+    Benchmarks the working memory of the knapsack solvers on the given data and on scaled synthetic inputs.
+*/
+void bench_memory()
+{
+    std::cout << "=== Knapsack working memory ===" << std::endl;
+    for (const std::string budget_string : {"10000000", "30000000", "200000000"})
+    {
+        std::vector<std::unique_ptr<intersection::Region>> regions;
+        std::vector<std::unique_ptr<intersection::Route>> routes;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(regions, routes, budget, min_cost, cost_gcd,
+            "1,2,3,4,5,6", budget_string, "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+        store::all(regions, routes);
+        compare_memory("data/ with budget " + budget_string, routes, budget, min_cost, cost_gcd);
+    }
+
+    for (int count : {200, 1000})
+    {
+        for (double budget : {1e4, 1e5})
+        {
+            std::vector<std::unique_ptr<intersection::Route>> routes;
+            synthetic_routes(routes, count, 1.0, 50, 17);
+            double min_cost = std::numeric_limits<double>::infinity();
+            for (auto& route : routes) { min_cost = std::min(min_cost, route->cost); }
+            compare_memory("synthetic", routes, budget, min_cost, 1.0);
+        }
+    }
+}
+
+/**
+    Benchmarks one route layer of the knapsack table with the scalar and the vectorized max-plus kernels.
+*/
+void bench_kernel()
+{
+    std::cout << "=== Max-plus kernel per route layer ===" << std::endl;
+    std::mt19937 generator {5};
+    std::uniform_real_distribution<double> values {0.0, 1e6};
+
+    intersection::Route route;
+    route.benefits = {1000.0, 1800.0, 2400.0};
+    for (size_t columns : {1000, 10000, 100000, 1000000})
+    {
+        std::vector<double> previous(columns);
+        for (auto& value : previous) { value = values(generator); }
+        std::vector<double> scalar(columns);
+        std::vector<double> picked(columns);
+        size_t repeats = std::max<size_t>(1, 100000000 / columns);
+
+        clock_t start = clock();
+        for (size_t r = 0; r < repeats; ++r)
+        {
+            knapsack::layer(route, 7, previous.data(), scalar.data(), columns, nullptr, knapsack::maxplus_scalar);
+        }
+        double scalar_time = since(start);
+
+        start = clock();
+        for (size_t r = 0; r < repeats; ++r)
+        {
+            knapsack::layer(route, 7, previous.data(), picked.data(), columns);
+        }
+        double picked_time = since(start);
+
+        std::cout << "    " << columns << " budget units: scalar " << 1e6*scalar_time/(repeats*columns)
+            << "ns per cell, picked kernel " << 1e6*picked_time/(repeats*columns)
+            << "ns per cell, speedup " << scalar_time/picked_time
+            << (scalar == picked ? ", same row" : ", DIFFERENT row") << std::endl;
+    }
+}
+
+/**
+    Benchmarks how filling a big knapsack table scales with the number of threads.
+*/
+void bench_threads()
+{
+    std::cout << "=== Knapsack table on several threads ===" << std::endl;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    synthetic_routes(routes, 60, 1.0, 50, 23);
+    const double budget = 5e5;
+
+    knapsack::Table serial;
+    auto start = std::chrono::steady_clock::now();
+    knapsack::solve(routes, budget, 1.0, serial);
+    std::chrono::duration<double, std::milli> serial_time = std::chrono::steady_clock::now() - start;
+    std::cout << "    1 thread: " << serial_time.count() << "ms" << std::endl;
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 2; threads <= std::max<size_t>(cores, 4); threads *= 2)
+    {
+        pool::Pool workers {threads};
+        knapsack::Table parallel;
+        start = std::chrono::steady_clock::now();
+        knapsack::solve(routes, budget, 1.0, parallel, &workers);
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        std::cout << "    " << threads << " threads: " << time.count() << "ms, speedup " << serial_time.count()/time.count()
+            << (parallel.values == serial.values ? ", same table" : ", DIFFERENT table") << std::endl;
+    }
+    std::cout << "    (" << cores << " hardware threads available)" << std::endl;
+}
+
+/**
+    Benchmarks the approximation on routes whose costs have the greatest common divisor 1.
+*/
+void bench_epsilon()
+{
+    std::cout << "=== Approximation with tiny cost GCD ===" << std::endl;
+    for (int count : {150, 1000})
+    {
+        std::vector<std::unique_ptr<intersection::Route>> routes;
+        synthetic_routes(routes, count, 1.0, 50, 29);
+        std::mt19937 generator {31};
+        std::uniform_int_distribution<int> cost {600000, 4000000};
+        for (auto& route : routes) { route->cost = cost(generator); }
+        const double budget = 30000000;
+
+        for (double epsilon : {0.1, 0.05, 0.01})
+        {
+            std::map<int, int> allocation;
+            double upper_bound;
+            clock_t start = clock();
+            double value = knapsack::approximate(routes, budget, epsilon, allocation, upper_bound);
+            std::cout << "    " << count << " routes, epsilon " << epsilon << ": " << since(start) << "ms, value "
+                << value << ", optimum at most " << upper_bound << std::endl;
+        }
+        std::cout << "    (the exact table would have " << knapsack::units(budget, 1.0) + 1 << " budget units per route)" << std::endl;
+    }
+}
+
+/**
+    Benchmarks one route layer with many buses with the generic and the concavity-aware update.
+*/
+void bench_concave()
+{
+    std::cout << "=== Concave route layer ===" << std::endl;
+    const size_t columns = 200000;
+    std::mt19937 generator {37};
+    std::uniform_real_distribution<double> values {0.0, 1e6};
+    std::vector<double> previous(columns);
+    for (auto& value : previous) { value = values(generator); }
+
+    for (int buses : {4, 16, 64, 256})
+    {
+        intersection::Route route;
+        route.buses = {buses, buses/2, 1};
+        route.benefits.assign(buses, 0.0);
+        for (int s = 0; s < intersection::TIMESLOTS; ++s)
+        {
+            double slot_targets = values(generator);
+            for (int b = 0; b < buses; ++b) { route.benefits[b] += std::min(b+1, route.buses[s])*slot_targets; }
+        }
+
+        for (size_t cost_units : {1, 10})
+        {
+            std::vector<double> generic(columns);
+            std::vector<double> specialised(columns);
+            clock_t start = clock();
+            knapsack::cells(route, cost_units, previous.data(), generic.data(), 0, columns, knapsack::kernel());
+            double generic_time = since(start);
+            start = clock();
+            knapsack::concave_cells(route, cost_units, previous.data(), specialised.data(), 0, columns);
+            double concave_time = since(start);
+            std::cout << "    " << buses << " buses, cost " << cost_units << ": generic " << generic_time
+                << "ms, concave " << concave_time << "ms"
+                << (generic == specialised ? ", same row" : ", DIFFERENT row") << std::endl;
+        }
+    }
+}
+
+/**
+    Benchmarks re-optimizing after a stream of random single-route edits against solving again.
+*/
+void bench_whatif()
+{
+    std::cout << "=== What-if re-optimization ===" << std::endl;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    synthetic_routes(routes, 1000, 1.0, 50, 41);
+    const double budget = 20000;
+    double min_cost = std::numeric_limits<double>::infinity();
+    for (auto& route : routes) { min_cost = std::min(min_cost, route->cost); }
+
+    clock_t start = clock();
+    knapsack::WhatIf what_if;
+    knapsack::prepare(routes, budget, 1.0, what_if);
+    std::cout << "    preparing prefix and suffix tables: " << since(start) << "ms" << std::endl;
+
+    std::mt19937 generator {43};
+    std::uniform_int_distribution<size_t> index {0, routes.size()-1};
+    std::uniform_real_distribution<double> factor {0.5, 1.5};
+    const int edits = 200;
+    double edit_time = 0.0;
+    double solve_time = 0.0;
+    int same = 0;
+    for (int e = 0; e < edits; ++e)
+    {
+        size_t changed_index = index(generator);
+        intersection::Route changed = *routes[changed_index];
+        changed.cost = std::max(1.0, std::round(changed.cost * factor(generator)));
+        for (auto& benefit : changed.benefits) { benefit *= factor(generator); }
+        std::sort(changed.benefits.begin(), changed.benefits.end());
+
+        std::map<int, int> allocation;
+        start = clock();
+        double value = knapsack::reoptimize(what_if, routes, changed_index, changed, allocation);
+        edit_time += since(start);
+
+        if (e % 20 == 0)
+        {
+            auto saved = *routes[changed_index];
+            *routes[changed_index] = changed;
+            std::map<int, int> solved_allocation;
+            start = clock();
+            double solved_value = knapsack::optimize(routes, budget, std::min(min_cost, changed.cost), 1.0, solved_allocation);
+            solve_time += since(start);
+            *routes[changed_index] = saved;
+            if (std::abs(value - solved_value) <= 1e-9*solved_value) { ++same; }
+        }
+    }
+    std::cout << "    " << edits << " edits: " << edit_time/edits << "ms per re-optimization, "
+        << solve_time/(edits/20) << "ms per full solve, " << same << "/" << edits/20 << " checked values agree" << std::endl;
+}
+
+/**
+    Copies the given regions and routes into a store, where they keep their indices.
+
+    @param regions the regions
+    @param routes the routes
+    @return the store
+*/
+store::Store stored(
+    const std::vector<std::unique_ptr<intersection::Region>>& regions,
+    const std::vector<std::unique_ptr<intersection::Route>>& routes)
+{
+    store::Store store;
+    for (const auto& region : regions) { store::add(store, *region); }
+    for (const auto& route : routes) { store::add(store, *route); }
+    return store;
+}
+
+/**
+    Benchmarks the intersection phase with the grid of regions against the full scan of all regions.
+*/
+void bench_grid()
+{
+    std::cout << "=== Mesh grid of regions ===" << std::endl;
+    for (int side : {100, 316, 1000})
+    {
+        std::vector<std::unique_ptr<intersection::Region>> regions;
+        intersection::Index index;
+        clock_t start = clock();
+        synthetic_mesh(regions, index.grid, side, 0.01, 47);
+        double build_time = since(start);
+
+        std::vector<std::unique_ptr<intersection::Route>> routes;
+        intersection::Box area {intersection::Point{139.0, 35.0}, intersection::Point{139.0 + side*0.01, 35.0 + side*0.01}};
+        synthetic_geometry(routes, 30, 300, 0.02, area, 53);
+
+        store::Store store = stored(regions, routes);
+        start = clock();
+        store::all(store);
+        double scan_time = since(start);
+        std::vector<double> scanned = store.benefits;
+
+        start = clock();
+        store::all(store, &index);
+        double grid_time = since(start);
+        bool same = store.benefits == scanned;
+
+        std::cout << "    " << regions.size() << " cells: full scan " << scan_time << "ms, grid " << grid_time
+            << "ms (plus " << build_time << "ms creating and filing the regions)"
+            << (same ? ", same benefits" : ", DIFFERENT benefits") << std::endl;
+    }
+}
+
+/**
+    Creates rectangular regions of random position and size inside the given area, with random targets.
+
+    @param regions the vector to store the regions
+    @param count the number of regions
+    @param size the maximal side length of a region
+    @param area the area containing the regions
+    @param seed the seed of the random number generator
+*/
+void synthetic_rectangles(
+    std::vector<std::unique_ptr<intersection::Region>>& regions,
+    int count,
+    double size,
+    const intersection::Box& area,
+    unsigned seed)
+{
+    std::mt19937 generator {seed};
+    std::uniform_real_distribution<double> x {area[0][0], area[1][0] - size};
+    std::uniform_real_distribution<double> y {area[0][1], area[1][1] - size};
+    std::uniform_real_distribution<double> side {size/10, size};
+    std::uniform_real_distribution<double> targets {0.0, 100.0};
+    for (int r = 0; r < count; ++r)
+    {
+        auto region = std::make_unique<intersection::Region>();
+        region->meshId = r;
+        for (auto& target : region->targets) { target = targets(generator); }
+        double left = x(generator);
+        double bottom = y(generator);
+        double right = left + side(generator);
+        double top = bottom + side(generator);
+        region->polygon = {{left, bottom}, {left, top}, {right, top}, {right, bottom}, {left, bottom}};
+        intersection::split(region->polygon, region->edges);
+        region->box = {intersection::Point{left, bottom}, intersection::Point{right, top}};
+        regions.push_back(std::move(region));
+    }
+}
+
+/**
+    Benchmarks the R-tree of irregular regions against looking at all regions.
+*/
+void bench_rtree()
+{
+    std::cout << "=== R-tree of irregular regions ===" << std::endl;
+    intersection::Box area {intersection::Point{139.0, 35.0}, intersection::Point{140.0, 36.0}};
+    for (int count : {1000, 10000, 100000})
+    {
+        std::vector<std::unique_ptr<intersection::Region>> regions;
+        synthetic_rectangles(regions, count, 10.0/std::sqrt(count), area, 59);
+        std::vector<std::unique_ptr<intersection::Route>> routes;
+        synthetic_geometry(routes, 30, 300, 0.002, area, 61);
+
+        store::Store store = stored(regions, routes);
+        intersection::Counters scan_counters;
+        clock_t start = clock();
+        store::all(store, nullptr, &scan_counters);
+        double scan_time = since(start);
+        std::vector<double> scanned = store.benefits;
+
+        intersection::Index index;
+        start = clock();
+        std::vector<intersection::Box> boxes;
+        for (auto& region : regions) { boxes.push_back(region->box); }
+        intersection::build(index.tree, boxes);
+        double build_time = since(start);
+
+        for (bool per_polyline : {false, true})
+        {
+            index.per_polyline = per_polyline;
+            intersection::Counters counters;
+            start = clock();
+            store::all(store, &index, &counters);
+            double tree_time = since(start);
+            bool same = store.benefits == scanned;
+
+            std::cout << "    " << count << " regions, " << (per_polyline ? "polyline" : "route") << " boxes: full scan "
+                << scan_time << "ms (" << scan_counters.may << " box tests, " << scan_counters.must << " exact tests), R-tree "
+                << tree_time << "ms (" << counters.may << " box tests, " << counters.must << " exact tests, plus "
+                << build_time << "ms building)" << (same ? ", same benefits" : ", DIFFERENT benefits") << std::endl;
+        }
+    }
+}
+
+/**
+    Benchmarks the box hierarchy of the routes against testing all segments of a route.
+*/
+void bench_hierarchy()
+{
+    std::cout << "=== Box hierarchy of routes ===" << std::endl;
+    std::vector<std::unique_ptr<intersection::Region>> regions;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(regions, routes, budget, min_cost, cost_gcd,
+        "1,2,3,4,5,6", "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+
+    // every route is tested against every region whose box its box intersects
+    auto scan = [&](intersection::Counters& counters)
+    {
+        size_t hits = 0;
+        for (auto& route : routes)
+        {
+            for (auto& region : regions)
+            {
+                ++counters.may;
+                if (not intersection::may(region->box, route->box)) { continue; }
+                ++counters.must;
+                hits += intersection::must(*route, *region, &counters);
+            }
+        }
+        return hits;
+    };
+
+    intersection::Counters counters;
+    clock_t start = clock();
+    size_t hits = scan(counters);
+    double hierarchy_time = since(start);
+
+    intersection::Counters flat_counters;
+    for (auto& route : routes)
+    {
+        route->polyline_boxes.clear();
+        route->chunk_boxes.clear();
+    }
+    start = clock();
+    bool same = scan(flat_counters) == hits;
+    double flat_time = since(start);
+
+    std::cout << "    data/: " << flat_counters.must << " exact tests, all segments "
+        << flat_counters.segments << " segment pairs in " << flat_time << "ms, hierarchy "
+        << counters.segments << " segment pairs in " << hierarchy_time << "ms"
+        << (same ? ", same intersections" : ", DIFFERENT intersections") << std::endl;
+}
+
+/**
+    Benchmarks the intersection phase on several threads, on routes of very uneven lengths.
+*/
+void bench_intersect()
+{
+    std::cout << "=== Intersections on several threads ===" << std::endl;
+    std::vector<std::unique_ptr<intersection::Region>> regions;
+    synthetic_rectangles(regions, 20000, 0.02, intersection::Box{intersection::Point{139.0, 35.0}, intersection::Point{140.0, 36.0}}, 67);
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    for (int points : {30, 3000})
+    {
+        synthetic_geometry(routes, 60, points, 0.01, intersection::Box{intersection::Point{139.0, 35.0}, intersection::Point{140.0, 36.0}}, 71 + points);
+    }
+
+    store::Store store = stored(regions, routes);
+    auto start = std::chrono::steady_clock::now();
+    store::all(store);
+    std::chrono::duration<double, std::milli> serial_time = std::chrono::steady_clock::now() - start;
+    std::vector<double> benefits = store.benefits;
+    std::cout << "    1 thread: " << serial_time.count() << "ms" << std::endl;
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 2; threads <= std::max<size_t>(cores, 4); threads *= 2)
+    {
+        pool::Pool workers {threads};
+        start = std::chrono::steady_clock::now();
+        store::all(store, nullptr, nullptr, &workers);
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        bool same = store.benefits == benefits;
+        std::cout << "    " << threads << " threads: " << time.count() << "ms, speedup " << serial_time.count()/time.count()
+            << (same ? ", same benefits" : ", DIFFERENT benefits") << std::endl;
+    }
+    std::cout << "    (" << cores << " hardware threads available)" << std::endl;
+}
+
+/**
+    Benchmarks the edge kernels on all segments of the given routes against the regions near them.
+*/
+void bench_edges()
+{
+    std::cout << "=== Segment against polygon edges ===" << std::endl;
+    std::vector<std::unique_ptr<intersection::Region>> regions;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(regions, routes, budget, min_cost, cost_gcd,
+        "1,2,3,4,5,6", "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+
+    std::vector<std::pair<const intersection::Route*, const intersection::Region*>> pairs;
+    for (auto& route : routes)
+    {
+        for (auto& region : regions)
+        {
+            if (intersection::may(route->box, region->box)) { pairs.emplace_back(route.get(), region.get()); }
+        }
+    }
+
+    auto measure = [&pairs](const std::function<bool(const intersection::Point&, const intersection::Point&, const intersection::Region&)>& test)
+    {
+        size_t hits = 0;
+        clock_t start = clock();
+        for (int repeat = 0; repeat < 3; ++repeat)
+        {
+            for (auto& pair : pairs)
+            {
+                for (auto& polyline : pair.first->polylines)
+                {
+                    for (size_t i = 0; i+1 < polyline.size(); ++i) { hits += test(polyline[i], polyline[i+1], *pair.second); }
+                }
+            }
+        }
+        return std::make_pair(since(start), hits);
+    };
+
+    auto single = measure([](const intersection::Point& a, const intersection::Point& b, const intersection::Region& region)
+        { return intersection::must(a, b, region.polygon); });
+    auto scalar = measure([](const intersection::Point& a, const intersection::Point& b, const intersection::Region& region)
+        { return not intersection::apart(a, b, region.box) and intersection::edges_scalar(a, b, region.edges, 0, region.edges.c_x.size()); });
+    auto picked = measure([](const intersection::Point& a, const intersection::Point& b, const intersection::Region& region)
+        { return not intersection::apart(a, b, region.box) and intersection::edge_kernel()(a, b, region.edges, 0, region.edges.c_x.size()); });
+
+    std::cout << "    " << pairs.size() << " route and region pairs, 3 times: one edge at a time " << single.first
+        << "ms, scalar kernel " << scalar.first << "ms, vector kernel " << picked.first << "ms"
+        << (single.second == scalar.second and single.second == picked.second ? ", same hits" : ", DIFFERENT hits") << std::endl;
+
+    // polygons with many edges, where the segments lie inside the bounds of the polygons
+    std::vector<std::unique_ptr<intersection::Region>> circles;
+    std::mt19937 generator {73};
+    std::uniform_real_distribution<double> unit {0.0, 1.0};
+    for (int c = 0; c < 2000; ++c)
+    {
+        auto region = std::make_unique<intersection::Region>();
+        for (int p = 0; p <= 64; ++p)
+        {
+            double angle = 2*M_PI*(p % 64)/64;
+            region->polygon.push_back(intersection::Point{std::cos(angle), std::sin(angle)});
+        }
+        intersection::split(region->polygon, region->edges);
+        region->box = {intersection::Point{-1.0, -1.0}, intersection::Point{1.0, 1.0}};
+        circles.push_back(std::move(region));
+    }
+    std::vector<intersection::Point> points;
+    for (int p = 0; p < 200; ++p) { points.push_back(intersection::Point{1.4*unit(generator) - 0.7, 1.4*unit(generator) - 0.7}); }
+
+    pairs.clear();
+    auto walk = std::make_unique<intersection::Route>();
+    walk->polylines.push_back(points);
+    for (auto& circle : circles) { pairs.emplace_back(walk.get(), circle.get()); }
+    single = measure([](const intersection::Point& a, const intersection::Point& b, const intersection::Region& region)
+        { return intersection::must(a, b, region.polygon); });
+    scalar = measure([](const intersection::Point& a, const intersection::Point& b, const intersection::Region& region)
+        { return not intersection::apart(a, b, region.box) and intersection::edges_scalar(a, b, region.edges, 0, region.edges.c_x.size()); });
+    picked = measure([](const intersection::Point& a, const intersection::Point& b, const intersection::Region& region)
+        { return not intersection::apart(a, b, region.box) and intersection::edge_kernel()(a, b, region.edges, 0, region.edges.c_x.size()); });
+
+    std::cout << "    " << pairs.size()*(points.size()-1) << " segments against 64 edges, 3 times: one edge at a time " << single.first
+        << "ms, scalar kernel " << scalar.first << "ms, vector kernel " << picked.first << "ms"
+        << (single.second == scalar.second and single.second == picked.second ? ", same hits" : ", DIFFERENT hits") << std::endl;
+}
+
+/**
+    Reads the peak resident set size of this process.
+
+    @return the peak resident set size in kilobytes, or 0 if it is unknown
+*/
+size_t peak_rss()
+{
+    std::ifstream status {"/proc/self/status"};
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0) { return std::stoul(line.substr(6)); }
+    }
+    return 0;
+}
+
+/**
+    Runs the given measurement in a child process, so that it has its own peak resident set size.
+
+    @param measure the measurement
+*/
+void isolated(const std::function<void()>& measure)
+{
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        measure();
+        std::cout.flush();
+        _exit(0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+}
+
+/**
+    Benchmarks parsing the example data into the flat geometry store and scanning all of its regions.
+*/
+void bench_store()
+{
+    std::cout << "=== Flat geometry store ===" << std::endl;
+    const std::string regions_path = "./data/Population_1.geojson";
+    const std::string routes_path = "./data/Route.geojson";
+    const std::string active_path = "./data/active.csv";
+
+    isolated([&]()
+    {
+        store::Store store;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        size_t before = allocations;
+        clock_t start = clock();
+        parse::input(store, budget, min_cost, cost_gcd, "1,2,3,4,5,6", "10000000", regions_path, routes_path, active_path);
+        double parse_time = since(start);
+        size_t parse_allocations = allocations - before;
+
+        start = clock();
+        for (int repeat = 0; repeat < 10; ++repeat) { store::all(store); }
+        std::cout << "    store:   " << parse_allocations << " allocations and " << parse_time << "ms parsing, "
+            << since(start)/10 << "ms per full scan, peak RSS " << peak_rss() << " kB" << std::endl;
+    });
+}
+
+/**
+    Compares a cold start, which parses all polygons, computes the intersections and writes the cache file,
+    with a warm start, which reads the cache file and only the regions' targets, on the example data.
+*/
+void bench_cache()
+{
+    std::cout << "=== Incidence cache ===" << std::endl;
+    const std::string path = "./bench.cache";
+    std::remove(path.c_str());
+
+    for (const char* start_name : {"cold", "warm", "warm"})
+    {
+        store::Store store;
+        intersection::Index index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        clock_t start = clock();
+        bool warm = cache::input(path, store, budget, min_cost, cost_gcd,
+            "1,2,3,4,5,6", "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &index);
+        std::cout << "    " << start_name << " start: " << since(start) << "ms" << (warm ? " from the cache" : "") << std::endl;
+    }
+    std::remove(path.c_str());
+}
+
+/**
+    Compares evaluating the routes for other target ages by parsing and intersecting again with computing
+    the targets from the raw population and multiplying them with the incidence matrix.
+*/
+void bench_ages()
+{
+    std::cout << "=== Target ages ===" << std::endl;
+    const std::string regions_path = "./data/Population_1.geojson";
+    const std::string routes_path = "./data/Route.geojson";
+    const std::string active_path = "./data/active.csv";
+    const std::vector<std::string> age_strings {"1,2,5", "6", "1,3,5", "2,4,6", "1,2,3,4,5,6"};
+
+    clock_t start = clock();
+    for (const auto& age_string : age_strings)
+    {
+        store::Store store;
+        intersection::Index index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(store, budget, min_cost, cost_gcd, age_string, "10000000", regions_path, routes_path, active_path, &index);
+        store::all(store, &index);
+    }
+    std::cout << "    parse and intersect: " << since(start)/age_strings.size() << "ms per age set" << std::endl;
+
+    store::Store store;
+    intersection::Index index;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(store, budget, min_cost, cost_gcd, "1,2,3,4,5,6", "10000000", regions_path, routes_path, active_path, &index);
+    store::Incidence incidence;
+    store::all(store, &index, nullptr, nullptr, &incidence);
+    auto active_factors = parse::active_factors(active_path);
+
+    const int repeats = 100;
+    start = clock();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        for (const auto& age_string : age_strings)
+        {
+            store::benefits(store, incidence, store::targets(store, parse::target_ages(age_string), active_factors));
+        }
+    }
+    std::cout << "    population and incidence (" << incidence.columns.size() << " nonzeros): "
+        << since(start)/(repeats*age_strings.size()) << "ms per age set" << std::endl;
+}
+
+/**
+    Measures the throughput of parsing the example GeoJSON files into the store, in megabytes per second
+    of file contents, and the heap allocations it takes, and how parsing the regions scales with threads.
+*/
+void bench_read()
+{
+    std::cout << "=== GeoJSON reading ===" << std::endl;
+    const std::string regions_path = "./data/Population_1.geojson";
+    const std::string routes_path = "./data/Route.geojson";
+    auto active_factors = parse::active_factors("./data/active.csv");
+    auto megabytes = [](const std::string& filename)
+    {
+        std::ifstream stream {filename, std::ios::binary | std::ios::ate};
+        return static_cast<double>(stream.tellg()) / (1 << 20);
+    };
+
+    const int repeats = 10;
+    intersection::Box everywhere {intersection::infimum, intersection::supremum};
+    size_t before = allocations;
+    clock_t start = clock();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        store::Store store;
+        parse::all_regions(store, "123456", active_factors, everywhere, regions_path);
+    }
+    double time = since(start) / repeats;
+    std::cout << "    regions: " << megabytes(regions_path) / time * 1000 << " MB/s, "
+        << (allocations - before) / repeats << " allocations" << std::endl;
+
+    before = allocations;
+    start = clock();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        store::Store store;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        parse::all_routes(store, min_cost, cost_gcd, routes_boundary, routes_path);
+    }
+    time = since(start) / repeats;
+    std::cout << "    routes:  " << megabytes(routes_path) / time * 1000 << " MB/s, "
+        << (allocations - before) / repeats << " allocations" << std::endl;
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= std::max<size_t>(cores, 4); threads *= 2)
+    {
+        pool::Pool workers {threads};
+        auto wall = std::chrono::steady_clock::now();
+        for (int repeat = 0; repeat < repeats; ++repeat)
+        {
+            store::Store store;
+            parse::all_regions(store, "123456", active_factors, everywhere, regions_path, nullptr, &workers);
+        }
+        std::chrono::duration<double, std::milli> wall_time = std::chrono::steady_clock::now() - wall;
+        std::cout << "    regions on " << threads << " threads: "
+            << megabytes(regions_path) / wall_time.count() * repeats * 1000 << " MB/s" << std::endl;
+    }
+    std::cout << "    (" << cores << " hardware threads available)" << std::endl;
+}
+
+/**
+    Compares loading the example data from the GeoJSON files with loading it from binary datasets
+    converted from them, on one thread.
+*/
+void bench_dataset()
+{
+    std::cout << "=== Binary dataset ===" << std::endl;
+    const std::string regions_path = "./bench.regions";
+    const std::string routes_path = "./bench.routes";
+    {
+        store::Store store;
+        intersection::Box everywhere {intersection::infimum, intersection::supremum};
+        parse::all_regions(store, "", {0., 0., 0.}, everywhere, "./data/Population_1.geojson");
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        parse::all_routes(store, min_cost, cost_gcd, routes_boundary, "./data/Route.geojson");
+        dataset::save_regions(regions_path, store);
+        dataset::save_routes(routes_path, store);
+    }
+
+    const int repeats = 10;
+    for (int binary = 0; binary < 2; ++binary)
+    {
+        clock_t start = clock();
+        for (int repeat = 0; repeat < repeats; ++repeat)
+        {
+            store::Store store;
+            intersection::Index index;
+            double budget;
+            double cost_gcd {0.0};
+            double min_cost {std::numeric_limits<double>::infinity()};
+            parse::input(store, budget, min_cost, cost_gcd, "1,2,3,4,5,6", "10000000",
+                binary ? regions_path : "./data/Population_1.geojson", binary ? routes_path : "./data/Route.geojson",
+                "./data/active.csv", &index);
+        }
+        std::cout << "    " << (binary ? "binary: " : "GeoJSON: ") << since(start)/repeats << "ms per load" << std::endl;
+    }
+    std::remove(regions_path.c_str());
+    std::remove(routes_path.c_str());
+}
+
+/**
+    Compares the peak resident set size and the time of parsing all regions into the store and intersecting
+    them with streaming the regions through the routes, on the example regions repeated several times.
+*/
+void bench_stream()
+{
+    std::cout << "=== Streaming regions ===" << std::endl;
+    const std::string regions_path = "./bench.geojson";
+    const std::string routes_path = "./data/Route.geojson";
+    const std::string active_path = "./data/active.csv";
+    std::string lines;
+    {
+        std::ifstream stream {"./data/Population_1.geojson", std::ios::binary};
+        lines.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+
+    for (int copies : {1, 4, 16})
+    {
+        {
+            std::ofstream stream {regions_path, std::ios::binary};
+            for (int copy = 0; copy < copies; ++copy) { stream << lines; }
+        }
+        for (int streaming = 0; streaming < 2; ++streaming)
+        {
+            isolated([&]()
+            {
+                store::Store store;
+                double budget;
+                double cost_gcd {0.0};
+                double min_cost {std::numeric_limits<double>::infinity()};
+                clock_t start = clock();
+                if (streaming)
+                {
+                    parse::stream(store, budget, min_cost, cost_gcd, "1,2,3,4,5,6", "10000000", regions_path, routes_path, active_path);
+                }
+                else
+                {
+                    intersection::Index index;
+                    parse::input(store, budget, min_cost, cost_gcd, "1,2,3,4,5,6", "10000000", regions_path, routes_path, active_path, &index);
+                    store::all(store, &index);
+                }
+                std::cout << "    " << copies << "x regions, " << (streaming ? "streamed: " : "stored:   ") << since(start)
+                    << "ms, peak RSS " << peak_rss() << " kB" << std::endl;
+            });
+        }
+    }
+    std::remove(regions_path.c_str());
+}
+
+/**
+    Compares parsing the example regions into the store lazily, skipping the coordinates of the regions without
+    targets and the edges of the regions outside the routes, with parsing all of them, for sparse target ages.
+*/
+void bench_lazy()
+{
+    std::cout << "=== Lazy region parsing ===" << std::endl;
+    const std::string regions_path = "./data/Population_1.geojson";
+    auto active_factors = parse::active_factors("./data/active.csv");
+    store::Store routes;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+    parse::all_routes(routes, min_cost, cost_gcd, routes_boundary, "./data/Route.geojson");
+
+    const int repeats = 10;
+    for (std::string age_string : {"1,2,5", "2", "1,2,3,4,5,6"})
+    {
+        std::string target_ages = parse::target_ages(age_string);
+        size_t skipped = 0;
+        size_t total = 0;
+        parse::Mapping file {regions_path};
+        intersection::Region region;
+        const char* pos = file.begin();
+        const char* first;
+        const char* last;
+        const std::string coordinates = "coordinates";
+        while (parse::next_line(pos, file.end(), first, last))
+        {
+            total += last - first;
+            if (not parse::region(region, first, last, active_factors, target_ages, true, &routes_boundary)
+                or not region.polygon.empty())
+            {
+                continue;
+            }
+            skipped += last - std::search(first, last, coordinates.begin(), coordinates.end());
+        }
+
+        double times[2];
+        for (int lazy = 0; lazy < 2; ++lazy)
+        {
+            clock_t start = clock();
+            for (int repeat = 0; repeat < repeats; ++repeat)
+            {
+                store::Store store;
+                parse::all_regions(store, target_ages, active_factors, routes_boundary, regions_path, nullptr, nullptr, lazy);
+            }
+            times[lazy] = since(start) / repeats;
+        }
+        std::cout << "    ages " << age_string << ": all " << times[0] << "ms, lazy " << times[1] << "ms, "
+            << skipped << " of " << total << " bytes skipped" << std::endl;
+    }
+}
+
+/**
+    Compares the wall time of a whole input, that is, parsing and intersecting, from the GeoJSON files with the
+    same from their gzip and zstd files, which are decompressed on a background thread, on the example regions
+    repeated several times. The zstd files are only made and read if the zstd program is installed.
+*/
+void bench_compressed()
+{
+    std::cout << "=== Compressed input ===" << std::endl;
+    const int copies = 8;
+    std::string regions;
+    std::string routes;
+    {
+        std::ifstream stream {"./data/Population_1.geojson", std::ios::binary};
+        std::string lines {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        for (int copy = 0; copy < copies; ++copy) { regions += lines; }
+        std::ifstream route_stream {"./data/Route.geojson", std::ios::binary};
+        routes.assign(std::istreambuf_iterator<char>(route_stream), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream {"./bench.regions.geojson", std::ios::binary} << regions;
+        std::ofstream {"./bench.routes.geojson", std::ios::binary} << routes;
+    }
+    for (const std::string name : {"regions", "routes"})
+    {
+        const std::string& text = name == "regions" ? regions : routes;
+        gzFile file = gzopen(("./bench." + name + ".geojson.gz").c_str(), "wb6");
+        gzwrite(file, text.data(), static_cast<unsigned>(text.size()));
+        gzclose(file);
+    }
+    bool zstd = std::system("zstd -qf ./bench.regions.geojson ./bench.routes.geojson 2> /dev/null") == 0;
+
+    std::vector<std::string> extensions {"", ".gz"};
+    if (zstd) { extensions.push_back(".zst"); }
+    for (const auto& extension : extensions)
+    {
+        std::string regions_path = "./bench.regions.geojson" + extension;
+        std::string routes_path = "./bench.routes.geojson" + extension;
+        std::ifstream compressed_stream {regions_path, std::ios::binary | std::ios::ate};
+        double megabytes = static_cast<double>(compressed_stream.tellg()) / (1 << 20);
+        for (int streaming = 0; streaming < 2; ++streaming)
+        {
+            const int repeats = 5;
+            auto wall = std::chrono::steady_clock::now();
+            for (int repeat = 0; repeat < repeats; ++repeat)
+            {
+                store::Store store;
+                double budget;
+                double cost_gcd {0.0};
+                double min_cost {std::numeric_limits<double>::infinity()};
+                if (streaming)
+                {
+                    parse::stream(store, budget, min_cost, cost_gcd, "1,2,5", "10000000", regions_path, routes_path, "./data/active.csv");
+                }
+                else
+                {
+                    intersection::Index index;
+                    parse::input(store, budget, min_cost, cost_gcd, "1,2,5", "10000000",
+                        regions_path, routes_path, "./data/active.csv", &index, nullptr, true);
+                    store::all(store, &index);
+                }
+            }
+            std::chrono::duration<double, std::milli> wall_time = std::chrono::steady_clock::now() - wall;
+            std::cout << "    " << (extension.empty() ? "GeoJSON" : extension) << " (" << megabytes << " MB of regions), "
+                << (streaming ? "streamed: " : "stored:   ") << wall_time.count() / repeats << "ms" << std::endl;
+        }
+        if (not extension.empty())
+        {
+            std::remove(regions_path.c_str());
+            std::remove(routes_path.c_str());
+        }
+    }
+    if (not zstd) { std::cout << "    (zstd is not installed)" << std::endl; }
+    std::remove("./bench.regions.geojson");
+    std::remove("./bench.routes.geojson");
+}
+
+/**
+    Measures the latencies of a server answering many queries, while it reloads a changed routes file in the
+    middle, and compares them with parsing and intersecting for every query. The queries and answers go through
+    named pipes, so the routes file is only changed once the server has answered its first query.
+*/
+void bench_server()
+{
+    std::cout << "=== Resident server ===" << std::endl;
+    const std::string regions_path = "./data/Population_1.geojson";
+    const std::string routes_path = "./bench.routes.geojson";
+    const std::string queries_path = "./bench.queries";
+    const std::string answers_path = "./bench.answers";
+    std::string routes;
+    {
+        std::ifstream stream {"./data/Route.geojson", std::ios::binary};
+        routes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        std::ofstream {routes_path, std::ios::binary} << routes;
+    }
+    ::mkfifo(queries_path.c_str(), 0600);
+    ::mkfifo(answers_path.c_str(), 0600);
+
+    const std::vector<std::string> age_strings {"1,2,5", "6", "1,3,5", "2,4,6", "1,2,3,4,5,6"};
+    const int count = 200;
+    std::vector<double> latencies;
+    std::thread serving([&]
+    {
+        std::ifstream in {queries_path};
+        std::ofstream out {answers_path};
+        latencies = server::serve(in, out, regions_path, routes_path);
+    });
+
+    std::ofstream queries {queries_path};
+    std::ifstream answers {answers_path};
+    std::string line;
+    auto query = [&](int q)
+    {
+        queries << age_strings[q % age_strings.size()] << "\n" << 1000000 * (1 + q % 30) << "\n./data/active.csv\n";
+    };
+    query(0);
+    queries.flush();
+    while (std::getline(answers, line) and line != "END") {}
+
+    // the server has its data, so the routes file can change: one route less
+    {
+        std::ofstream {routes_path, std::ios::binary} << routes.substr(0, routes.rfind("{\"type\": \"Feature\"")) << "]\n}\n";
+    }
+    queries << "RELOAD\n";
+    for (int q = 1; q < count; ++q) { query(q); }
+    queries.close();
+    int ends = 1;
+    while (std::getline(answers, line)) { ends += line == "END"; }
+    serving.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "    server: " << ends << " answers, latency p50 " << latencies[latencies.size() / 2] << "ms, p90 "
+        << latencies[latencies.size() * 9 / 10] << "ms, p99 " << latencies[latencies.size() * 99 / 100]
+        << "ms, max " << latencies.back() << "ms" << std::endl;
+
+    const int repeats = 10;
+    auto wall = std::chrono::steady_clock::now();
+    for (int q = 0; q < repeats; ++q)
+    {
+        store::Store store;
+        intersection::Index index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(store, budget, min_cost, cost_gcd, age_strings[q % age_strings.size()], std::to_string(1000000 * (1 + q % 30)),
+            regions_path, "./data/Route.geojson", "./data/active.csv", &index, nullptr, true);
+        store::all(store, &index);
+        std::vector<std::unique_ptr<intersection::Route>> items;
+        store::items(store, items);
+        std::map<int, int> allocation;
+        knapsack::optimize(items, budget, min_cost, cost_gcd, allocation);
+    }
+    std::chrono::duration<double, std::milli> wall_time = std::chrono::steady_clock::now() - wall;
+    std::cout << "    parsing for every query: " << wall_time.count() / repeats << "ms per query" << std::endl;
+
+    std::remove(routes_path.c_str());
+    std::remove(queries_path.c_str());
+    std::remove(answers_path.c_str());
+}
+
+/**
+    Compares answering a batch of queries one by one from the resident data with answering them in groups
+    of the same target ages, one table per group, on several threads.
+*/
+void bench_batch()
+{
+    std::cout << "=== Batch of queries ===" << std::endl;
+    auto data = server::load(cache::Key{}, "./data/Population_1.geojson", "./data/Route.geojson");
+    std::mt19937 random {25};
+    std::string queries;
+    const int count = 1000;
+    for (int q = 0; q < count; ++q)
+    {
+        std::string age_string;
+        int ages = std::uniform_int_distribution<int>(1, 63)(random);
+        for (int a = 0; a < 6; ++a)
+        {
+            if (ages & (1 << a)) { age_string += std::string(age_string.empty() ? "" : ",") + static_cast<char>('1' + a); }
+        }
+        queries += age_string + "\n" + std::to_string(100000 * std::uniform_int_distribution<int>(10, 300)(random)) + "\n./data/active.csv\n";
+    }
+
+    std::stringstream served_in {queries};
+    std::stringstream served_out;
+    auto wall = std::chrono::steady_clock::now();
+    std::string age_string;
+    std::string budget_string;
+    std::string active_path;
+    while (std::getline(served_in, age_string) and std::getline(served_in, budget_string) and std::getline(served_in, active_path))
+    {
+        std::map<int, int> allocation;
+        server::answer(*data, parse::target_ages(age_string), parse::active_factors(active_path), std::stod(budget_string), allocation);
+        for (const auto& iter : allocation) { served_out << iter.first << "," << iter.second << "\n"; }
+        served_out << "END\n";
+    }
+    std::chrono::duration<double, std::milli> wall_time = std::chrono::steady_clock::now() - wall;
+    std::cout << "    one by one: " << wall_time.count() << "ms for " << count << " queries" << std::endl;
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= std::max<size_t>(cores, 2); threads *= 2)
+    {
+        pool::Pool workers {threads};
+        {
+            // the first batch on new threads pays for the pages of their heaps
+            std::stringstream warm_in {queries};
+            std::stringstream warm_out;
+            server::batch(warm_in, warm_out, *data, &workers);
+        }
+        std::stringstream batch_in {queries};
+        std::stringstream batch_out;
+        wall = std::chrono::steady_clock::now();
+        size_t groups = server::batch(batch_in, batch_out, *data, &workers);
+        wall_time = std::chrono::steady_clock::now() - wall;
+        std::cout << "    batch on " << threads << " threads: " << wall_time.count() << "ms in " << groups << " groups"
+            << (batch_out.str() == served_out.str() ? ", same answers" : ", DIFFERENT answers") << std::endl;
+    }
+    std::cout << "    (" << cores << " hardware threads available)" << std::endl;
+}
+
+/**
+    Measures the throughput of parse::double_number and of strtod on all numbers of the example population file.
+*/
+void bench_doubles()
+{
+    std::cout << "=== Doubles ===" << std::endl;
+    std::ifstream stream {"./data/Population_1.geojson"};
+    std::string contents {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    std::string numbers;
+    size_t count = 0;
+    for (size_t pos = 0; pos < contents.size();)
+    {
+        if (not (contents[pos] >= '0' and contents[pos] <= '9')) { ++pos; continue; }
+        size_t end = contents.find_first_not_of("0123456789.", pos);
+        numbers.append(contents, pos, end - pos);
+        numbers.push_back(',');
+        ++count;
+        pos = end;
+    }
+    double megabytes = static_cast<double>(numbers.size()) / (1 << 20);
+
+    const int repeats = 10;
+    double sum = 0.0;
+    double strtod_sum = 0.0;
+    clock_t start = clock();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        const char* pos = numbers.data();
+        const char* end = numbers.data() + numbers.size();
+        for (double number; pos != end; ++pos)
+        {
+            parse::double_number(number, pos, end);
+            sum += number;
+        }
+    }
+    double time = since(start) / repeats;
+    std::cout << "    double_number: " << megabytes / time * 1000 << " MB/s, " << count / time / 1000 << " million numbers/s" << std::endl;
+
+    start = clock();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        char* pos = &numbers[0];
+        const char* end = numbers.data() + numbers.size();
+        while (pos != end)
+        {
+            strtod_sum += std::strtod(pos, &pos);
+            ++pos;
+        }
+    }
+    time = since(start) / repeats;
+    std::cout << "    strtod:        " << megabytes / time * 1000 << " MB/s, " << count / time / 1000 << " million numbers/s"
+        << (sum == strtod_sum ? "" : ", DIFFERENT numbers") << std::endl;
+}
+
+/**
+    Runs all the benchmarks, or only the one named by the first command line argument.
+
+    @param argc the number of command line arguments
+    @param argv the command line arguments
+    @return 0 meaning success
+*/
+int main(int argc, char* argv[])
+{
+    std::string only = argc > 1 ? argv[1] : "";
+    if (only.empty() or only == "memory") { bench_memory(); }
+    if (only.empty() or only == "kernel") { bench_kernel(); }
+    if (only.empty() or only == "threads") { bench_threads(); }
+    if (only.empty() or only == "epsilon") { bench_epsilon(); }
+    if (only.empty() or only == "concave") { bench_concave(); }
+    if (only.empty() or only == "whatif") { bench_whatif(); }
+    if (only.empty() or only == "grid") { bench_grid(); }
+    if (only.empty() or only == "rtree") { bench_rtree(); }
+    if (only.empty() or only == "hierarchy") { bench_hierarchy(); }
+    if (only.empty() or only == "intersect") { bench_intersect(); }
+    if (only.empty() or only == "edges") { bench_edges(); }
+    if (only.empty() or only == "store") { bench_store(); }
+    if (only.empty() or only == "cache") { bench_cache(); }
+    if (only.empty() or only == "ages") { bench_ages(); }
+    if (only.empty() or only == "read") { bench_read(); }
+    if (only.empty() or only == "dataset") { bench_dataset(); }
+    if (only.empty() or only == "doubles") { bench_doubles(); }
+    if (only.empty() or only == "stream") { bench_stream(); }
+    if (only.empty() or only == "lazy") { bench_lazy(); }
+    if (only.empty() or only == "compressed") { bench_compressed(); }
+    if (only.empty() or only == "server") { bench_server(); }
+    if (only.empty() or only == "batch") { bench_batch(); }
+    return 0;
+}
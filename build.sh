@@ -1,3 +1,3 @@
 #!/bin/bash
 
-g++ -Wall -Wextra -O2 -std=c++14 -o main Main.cpp
+g++ -Wall -Wextra -O2 -std=c++14 -pthread -o main Main.cpp -lz "$@"
@@ -0,0 +1,265 @@
+#pragma once
+
+namespace cache
+{
+    // identifies the files written by this version of the cache
+    const uint64_t MAGIC = 0x434e4953554231ULL;
+    const uint64_t VERSION = 1;
+
+    /**
+        Represents the files an incidence matrix has been computed from, by the hashes of their contents.
+    */
+    struct Key
+    {
+        uint64_t regions = 0;
+        uint64_t routes = 0;
+    };
+
+    /**
+        Continues the 64 bit FNV-1a hash of some bytes with some more bytes.
+
+        @param hash the hash of the bytes so far
+        @param bytes the more bytes
+        @param size the number of more bytes
+        @return the hash of all bytes
+    */
+    uint64_t fnv(uint64_t hash, const char* bytes, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<unsigned char>(bytes[i]);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    // the 64 bit FNV-1a hash of no bytes
+    const uint64_t FNV_BASIS = 0xcbf29ce484222325ULL;
+
+    /**
+        Hashes the contents of a file.
+
+        @param filename path to the file
+        @return the 64 bit FNV-1a hash of the file's contents
+    */
+    uint64_t hash(const std::string& filename)
+    {
+        std::ifstream stream {filename, std::ios::binary};
+        if (not stream.is_open())
+        {
+            std::clog << "Could not find the file " << filename << " to hash" << std::endl;
+            exit(-1);
+        }
+
+        uint64_t hash = FNV_BASIS;
+        std::vector<char> buffer(1 << 16);
+        while (stream)
+        {
+            stream.read(buffer.data(), buffer.size());
+            hash = fnv(hash, buffer.data(), stream.gcount());
+        }
+        return hash;
+    }
+
+    /**
+        Appends the bytes of a number to a buffer.
+
+        @param buffer the buffer
+        @param number the number
+    */
+    template<typename Number>
+    void put(std::string& buffer, Number number)
+    {
+        buffer.append(reinterpret_cast<const char*>(&number), sizeof(number));
+    }
+
+    /**
+        Reads the bytes of a number from a buffer.
+
+        @param buffer the buffer
+        @param pos the position of the number in the buffer, which is advanced past the number
+        @param number this will store the number
+        @return false if the buffer ended before the number
+    */
+    template<typename Number>
+    bool get(const std::string& buffer, size_t& pos, Number& number)
+    {
+        if (buffer.size() - pos < sizeof(number)) { return false; }
+        std::copy(buffer.data() + pos, buffer.data() + pos + sizeof(number), reinterpret_cast<char*>(&number));
+        pos += sizeof(number);
+        return true;
+    }
+
+    /**
+        Writes an incidence matrix to the cache file. The file is first written under a temporary name and
+        then renamed, so that other runs either see the old file or the complete new one.
+
+        @param path path to the cache file
+        @param key the hashes of the files the matrix has been computed from
+        @param region_features the number of region features in the regions file
+        @param incidence the regions each route intersects
+        @return false if the file could not be written
+    */
+    bool save(const std::string& path, const Key& key, size_t region_features, const store::Incidence& incidence)
+    {
+        std::string buffer;
+        put(buffer, MAGIC);
+        put(buffer, VERSION);
+        put(buffer, key.regions);
+        put(buffer, key.routes);
+        put(buffer, static_cast<uint64_t>(region_features));
+        put(buffer, static_cast<uint64_t>(incidence.starts.size() - 1));
+        put(buffer, static_cast<uint64_t>(incidence.columns.size()));
+        for (auto start : incidence.starts) { put(buffer, static_cast<uint64_t>(start)); }
+        for (auto column : incidence.columns) { put(buffer, column); }
+        put(buffer, fnv(FNV_BASIS, buffer.data(), buffer.size()));
+
+        std::string temporary = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream stream {temporary, std::ios::binary | std::ios::trunc};
+            stream.write(buffer.data(), buffer.size());
+            stream.close();
+            if (not stream)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+        Reads an incidence matrix from the cache file and validates it: the file must be complete and
+        unchanged, be computed from files with the given hashes, and describe a valid matrix.
+
+        @param path path to the cache file
+        @param key the hashes of the current files
+        @param region_features this will store the number of region features in the regions file
+        @param incidence this will store the regions each route intersects
+        @return false if there is no valid cache file for the given files
+    */
+    bool load(const std::string& path, const Key& key, size_t& region_features, store::Incidence& incidence)
+    {
+        std::ifstream stream {path, std::ios::binary};
+        if (not stream.is_open()) { return false; }
+        std::string buffer {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+
+        uint64_t checksum;
+        if (buffer.size() < sizeof(checksum)) { return false; }
+        size_t pos = buffer.size() - sizeof(checksum);
+        get(buffer, pos, checksum);
+        buffer.resize(buffer.size() - sizeof(checksum));
+        if (checksum != fnv(FNV_BASIS, buffer.data(), buffer.size())) { return false; }
+
+        pos = 0;
+        uint64_t magic, version, regions, routes, features, rows, columns;
+        if (not get(buffer, pos, magic) or not get(buffer, pos, version) or not get(buffer, pos, regions)
+            or not get(buffer, pos, routes) or not get(buffer, pos, features) or not get(buffer, pos, rows)
+            or not get(buffer, pos, columns))
+        {
+            return false;
+        }
+        if (magic != MAGIC or version != VERSION or regions != key.regions or routes != key.routes) { return false; }
+        if (buffer.size() - pos != (rows+1)*sizeof(uint64_t) + columns*sizeof(uint32_t)) { return false; }
+
+        incidence.starts.resize(rows+1);
+        incidence.columns.resize(columns);
+        for (auto& start : incidence.starts)
+        {
+            uint64_t value = 0;
+            get(buffer, pos, value);
+            start = value;
+        }
+        for (auto& column : incidence.columns) { get(buffer, pos, column); }
+
+        if (incidence.starts.front() != 0 or incidence.starts.back() != columns) { return false; }
+        for (size_t r = 0; r < rows; ++r)
+        {
+            if (incidence.starts[r] > incidence.starts[r+1]) { return false; }
+            for (size_t c = incidence.starts[r]; c < incidence.starts[r+1]; ++c)
+            {
+                if (incidence.columns[c] >= features) { return false; }
+                if (c > incidence.starts[r] and incidence.columns[c] <= incidence.columns[c-1]) { return false; }
+            }
+        }
+        region_features = features;
+        return true;
+    }
+
+    /**
+        Parses the entire input into the store and computes the benefits of all routes, using the cache file
+        if it holds the incidence matrix for the given GeoJSON files. Then the regions file is only read for
+        the regions' targets, skipping all coordinates, and no intersections are computed. Otherwise
+        the incidence matrix is computed and written to the cache file for the next run.
+
+        @param path path to the cache file
+        @param store the store to add the routes and, without a valid cache file, the regions to
+        @param budget total given budget
+        @param min_cost this is the minimum cost of any wrapping bus (needed for optimization)
+        @param cost_gcd this is the greatest divisor of the costs of all wrapping buses (needed for optimization)
+        @param age_string The comma-separated string of age groups read from the stdin
+        @param budget_string The budget string read from stdin
+        @param regions_path The path to the GeoJSON file with region data
+        @param routes_path The path to the GeoJSON file with route data
+        @param active_path The path to the CSV file with activity probabilities
+        @param index the index to file the parsed regions in, or nullptr
+        @param workers the threads to parse the files and compute intersections on, or nullptr
+        @return true if the cache file was used
+    */
+    bool input(
+        const std::string& path,
+        store::Store& store,
+        double& budget,
+        double& min_cost,
+        double& cost_gcd,
+        const std::string& age_string,
+        const std::string& budget_string,
+        const std::string& regions_path,
+        const std::string& routes_path,
+        const std::string& active_path,
+        intersection::Index* index = nullptr,
+        pool::Pool* workers = nullptr)
+    {
+        Key key {hash(regions_path), hash(routes_path)};
+        store::Incidence incidence;
+        size_t region_features = 0;
+        if (load(path, key, region_features, incidence))
+        {
+            std::string target_ages = parse::target_ages(age_string);
+            budget = parse::budget(budget_string);
+
+            intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+            store::Store routes_store;
+            double routes_min_cost = min_cost;
+            double routes_gcd = cost_gcd;
+            parse::all_routes(routes_store, routes_min_cost, routes_gcd, routes_boundary, routes_path, workers);
+
+            std::array<double, intersection::TIMESLOTS> active_factors = parse::active_factors(active_path);
+            auto targets = parse::all_targets(target_ages, active_factors, regions_path);
+
+            if (incidence.starts.size() == routes_store.output_ids.size() + 1 and targets.size() == region_features)
+            {
+                store = std::move(routes_store);
+                min_cost = routes_min_cost;
+                cost_gcd = routes_gcd;
+                store::benefits(store, incidence, targets);
+                return true;
+            }
+            std::clog << "The cache file " << path << " does not fit the GeoJSON files, computing the intersections again" << std::endl;
+        }
+
+        parse::input(store, budget, min_cost, cost_gcd,
+            age_string, budget_string, regions_path, routes_path, active_path, index, workers);
+        store::all(store, index, nullptr, workers, &incidence);
+        if (not save(path, key, store.region_features, incidence))
+        {
+            std::clog << "Could not write the cache file " << path << std::endl;
+        }
+        return false;
+    }
+}
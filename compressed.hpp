@@ -0,0 +1,298 @@
+#pragma once
+
+namespace compressed
+{
+    // the size of the blocks of decompressed text handed to the parser, and how many may wait for it
+    const size_t BLOCK = 1 << 20;
+    const size_t QUEUED = 4;
+
+    /**
+        Tells from its name whether a file is compressed, with gzip if it ends in ".gz"
+        or with zstd if it ends in ".zst".
+
+        @param filename path to the file
+        @return true if the file is compressed
+    */
+    bool is(const std::string& filename)
+    {
+        auto ends = [&](const std::string& suffix)
+        {
+            return filename.size() > suffix.size()
+                and filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        return ends(".gz") or ends(".zst");
+    }
+
+    /**
+        Represents a compressed file which is decompressed on a background thread while its text is being
+        parsed. The text comes in blocks of whole lines of about BLOCK bytes, and the thread stops decompressing
+        while QUEUED blocks wait to be parsed, so the memory does not grow with the file.
+
+        A gzip file is decompressed with zlib on the thread. A zstd file is decompressed with libzstd on the
+        thread if LIBZSTD is defined, otherwise by the zstd program, whose output the thread reads through a pipe.
+    */
+    class Reader
+    {
+    public:
+        /**
+            Starts decompressing the file.
+
+            @param filename path to the compressed file
+        */
+        explicit Reader(const std::string& filename)
+        {
+            struct stat status;
+            if (::stat(filename.c_str(), &status) != 0 or not S_ISREG(status.st_mode)) { return; }
+
+            opened = true;
+            thread = std::thread([this, filename]
+            {
+                bool gzip = filename.size() > 3 and filename.compare(filename.size() - 3, 3, ".gz") == 0;
+                bool read = gzip ? gunzip(filename) : unzstd(filename);
+                std::lock_guard<std::mutex> lock {mutex};
+                if (not read and not stopping) { failed = true; }
+                if (not rest.empty()) { blocks.push_back(std::move(rest)); }
+                done = true;
+                changed.notify_all();
+            });
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        /**
+            Stops decompressing and joins the thread.
+        */
+        ~Reader()
+        {
+            {
+                std::lock_guard<std::mutex> lock {mutex};
+                stopping = true;
+            }
+            changed.notify_all();
+            if (thread.joinable()) { thread.join(); }
+        }
+
+        /**
+            Returns whether the file exists.
+
+            @return true if the file is being decompressed
+        */
+        bool is_open() const
+        {
+            return opened;
+        }
+
+        /**
+            Waits for the next block of whole lines of the decompressed text.
+
+            @param block this will store the block, whose memory is handed back to the thread
+            @return false if the whole text has been read or the file is damaged, otherwise true
+        */
+        bool next(std::string& block)
+        {
+            std::unique_lock<std::mutex> lock {mutex};
+            if (block.capacity() > 0) { spare.push_back(std::move(block)); }
+            changed.wait(lock, [&] { return not blocks.empty() or done; });
+            changed.notify_all();
+            if (blocks.empty() or failed) { return false; }
+
+            block = std::move(blocks.front());
+            blocks.pop_front();
+            return true;
+        }
+
+        /**
+            Returns whether the file could not be decompressed completely. This is only known once
+            'next' has returned false.
+
+            @return true if the file is damaged or its decompressor failed
+        */
+        bool damaged()
+        {
+            std::lock_guard<std::mutex> lock {mutex};
+            return failed;
+        }
+
+        /**
+            Returns whether the file could not be decompressed because the zstd program is missing, which
+            cannot happen with libzstd. This is only known once 'next' has returned false.
+
+            @return true if the zstd program could not be run
+        */
+        bool missing()
+        {
+            std::lock_guard<std::mutex> lock {mutex};
+            return failed and absent;
+        }
+
+    private:
+        /**
+            Hands some decompressed bytes to the parser: they are appended to the unfinished block, and once
+            it has BLOCK bytes, its whole lines are queued and its last partial line begins the next block.
+
+            @param bytes the decompressed bytes
+            @param size the number of bytes
+            @return false if the reader is being stopped, otherwise true
+        */
+        bool put(const char* bytes, size_t size)
+        {
+            rest.append(bytes, size);
+            if (rest.size() < BLOCK) { return true; }
+
+            const char* newline = static_cast<const char*>(::memrchr(rest.data(), '\n', rest.size()));
+            if (not newline) { return true; }
+
+            std::unique_lock<std::mutex> lock {mutex};
+            changed.wait(lock, [&] { return blocks.size() < QUEUED or stopping; });
+            if (stopping) { return false; }
+
+            std::string next;
+            if (not spare.empty())
+            {
+                next = std::move(spare.back());
+                spare.pop_back();
+            }
+            size_t lines = newline + 1 - rest.data();
+            next.assign(rest, lines, std::string::npos);
+            rest.resize(lines);
+            blocks.push_back(std::move(rest));
+            rest = std::move(next);
+            changed.notify_all();
+            return true;
+        }
+
+        /**
+            Decompresses a gzip file, which may consist of several concatenated gzip streams.
+
+            @param filename path to the file
+            @return true if the whole file was decompressed
+        */
+        bool gunzip(const std::string& filename)
+        {
+            gzFile file = ::gzopen(filename.c_str(), "rb");
+            if (not file) { return false; }
+            ::gzbuffer(file, 1 << 17);
+
+            std::vector<char> buffer(1 << 17);
+            int size;
+            bool read = true;
+            while ((size = ::gzread(file, buffer.data(), static_cast<unsigned>(buffer.size()))) > 0)
+            {
+                if (not put(buffer.data(), static_cast<size_t>(size)))
+                {
+                    read = false;
+                    break;
+                }
+            }
+            int error = Z_OK;
+            ::gzerror(file, &error);
+            ::gzclose(file);
+            return read and size == 0 and error == Z_OK;
+        }
+
+#ifdef LIBZSTD
+        /**
+            Decompresses a zstd file with libzstd, which may consist of several concatenated zstd frames.
+
+            @param filename path to the file
+            @return true if the whole file was decompressed
+        */
+        bool unzstd(const std::string& filename)
+        {
+            int file = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0) { return false; }
+            ZSTD_DStream* stream = ::ZSTD_createDStream();
+
+            std::vector<char> input(::ZSTD_DStreamInSize());
+            std::vector<char> output(::ZSTD_DStreamOutSize());
+            ssize_t size;
+            // this is 0 whenever the last frame has been decompressed completely
+            size_t pending = 0;
+            bool read = stream != nullptr;
+            while (read and (size = ::read(file, input.data(), input.size())) != 0)
+            {
+                if (size < 0 and errno == EINTR) { continue; }
+                if (size < 0)
+                {
+                    read = false;
+                    break;
+                }
+
+                // a full output buffer may hold back more output even when all the input has been taken
+                ZSTD_inBuffer in {input.data(), static_cast<size_t>(size), 0};
+                ZSTD_outBuffer out {output.data(), output.size(), output.size()};
+                while (read and (in.pos < in.size or out.pos == out.size))
+                {
+                    out.pos = 0;
+                    pending = ::ZSTD_decompressStream(stream, &out, &in);
+                    read = not ::ZSTD_isError(pending) and put(output.data(), out.pos);
+                }
+            }
+            ::ZSTD_freeDStream(stream);
+            ::close(file);
+            return read and pending == 0;
+        }
+#else
+        /**
+            Decompresses a zstd file by running the zstd program and reading its output.
+
+            @param filename path to the file
+            @return true if the program decompressed the whole file
+        */
+        bool unzstd(const std::string& filename)
+        {
+            // both ends are closed on exec, so only their duplicate on the output of the program stays open there
+            int ends[2];
+            if (::pipe2(ends, O_CLOEXEC) != 0) { return false; }
+
+            posix_spawn_file_actions_t actions;
+            ::posix_spawn_file_actions_init(&actions);
+            ::posix_spawn_file_actions_adddup2(&actions, ends[1], STDOUT_FILENO);
+            ::posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+            const char* arguments[] {"zstd", "-dcq", "--", filename.c_str(), nullptr};
+            pid_t child;
+            int error = ::posix_spawnp(&child, "zstd", &actions, nullptr, const_cast<char* const*>(arguments), environ);
+            ::posix_spawn_file_actions_destroy(&actions);
+            ::close(ends[1]);
+            if (error != 0)
+            {
+                ::close(ends[0]);
+                absent = error == ENOENT;
+                return false;
+            }
+
+            std::vector<char> buffer(1 << 17);
+            ssize_t size;
+            bool read = true;
+            while ((size = ::read(ends[0], buffer.data(), buffer.size())) != 0)
+            {
+                if (size < 0 and errno == EINTR) { continue; }
+                if (size < 0 or not put(buffer.data(), static_cast<size_t>(size)))
+                {
+                    read = false;
+                    break;
+                }
+            }
+            ::close(ends[0]);
+
+            int status = 0;
+            while (::waitpid(child, &status, 0) < 0 and errno == EINTR) {}
+            return read and WIFEXITED(status) and WEXITSTATUS(status) == 0;
+        }
+#endif
+
+        bool opened = false;
+        std::string rest;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::string> blocks;
+        std::vector<std::string> spare;
+        bool done = false;
+        bool failed = false;
+        bool absent = false;
+        bool stopping = false;
+        std::thread thread;
+    };
+}
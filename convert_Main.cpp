@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef LIBZSTD
+#include <zstd.h>
+#endif
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#include <immintrin.h>
+#endif
+
+#include "pool.hpp"
+
+#include "intersection.hpp"
+
+#include "store.hpp"
+
+#include "dataset.hpp"
+
+#include "compressed.hpp"
+
+#include "knapsack.hpp"
+
+#include "parse.hpp"
+
+/**
+    Converts a GeoJSON file with region or route features into the binary dataset format, which the
+    program reads much faster. The binary file may then be given on stdin instead of the GeoJSON file.
+    All region features are kept with their raw population, so one binary file serves all target ages.
+
+    Usage: ./convert regions|routes INPUT_GEOJSON OUTPUT_FILE
+
+    @param argc the number of command line arguments
+    @param argv the command line arguments
+    @return 0 meaning success, -1 if the file could not be converted
+*/
+int main(int argc, char* argv[])
+{
+    std::string kind = argc == 4 ? argv[1] : "";
+    if (kind != "regions" and kind != "routes")
+    {
+        std::clog << "Usage: " << argv[0] << " regions|routes INPUT_GEOJSON OUTPUT_FILE" << std::endl;
+        return -1;
+    }
+
+    store::Store store;
+    bool written;
+    if (kind == "regions")
+    {
+        intersection::Box everywhere {intersection::infimum, intersection::supremum};
+        parse::all_regions(store, "", {0., 0., 0.}, everywhere, argv[2]);
+        written = dataset::save_regions(argv[3], store);
+        std::clog << "Converted " << store.region_features << " region features" << std::endl;
+    }
+    else
+    {
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        parse::all_routes(store, min_cost, cost_gcd, routes_boundary, argv[2]);
+        written = dataset::save_routes(argv[3], store);
+        std::clog << "Converted " << store.output_ids.size() << " routes" << std::endl;
+    }
+
+    if (not written)
+    {
+        std::clog << "Could not write the binary dataset " << argv[3] << std::endl;
+        return -1;
+    }
+    return 0;
+}
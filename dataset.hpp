@@ -0,0 +1,423 @@
+#pragma once
+
+namespace dataset
+{
+    // identifies the files of this binary format, whose first bytes are "1BUSDATA", and its version
+    const uint64_t MAGIC = 0x4154414453554231ULL;
+    const uint64_t VERSION = 1;
+
+    // the kinds of features in a file
+    const uint64_t REGIONS = 1;
+    const uint64_t ROUTES = 2;
+
+    /**
+        Computes a 64 bit checksum of some bytes, eight bytes at a time, in the manner of FNV-1a.
+
+        @param bytes the bytes
+        @param size the number of bytes
+        @return the checksum
+    */
+    uint64_t checksum(const char* bytes, size_t size)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        size_t words = size / sizeof(uint64_t);
+        for (size_t w = 0; w < words; ++w)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + w*sizeof(uint64_t), sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ULL;
+        }
+        for (size_t i = words*sizeof(uint64_t); i < size; ++i)
+        {
+            hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    /**
+        Appends the bytes of some values to a buffer, followed by zeros up to a multiple of eight bytes,
+        so that all arrays in a file start at aligned offsets.
+
+        @param buffer the buffer
+        @param values the values
+        @param count the number of values
+    */
+    template<typename Value>
+    void put(std::string& buffer, const Value* values, size_t count)
+    {
+        buffer.append(reinterpret_cast<const char*>(values), count*sizeof(Value));
+        buffer.append((8 - buffer.size() % 8) % 8, '\0');
+    }
+
+    /**
+        Appends the bytes of one number to a buffer.
+
+        @param buffer the buffer
+        @param number the number
+    */
+    void put(std::string& buffer, uint64_t number)
+    {
+        put(buffer, &number, 1);
+    }
+
+    /**
+        Represents the position of reading a file of this format, which fails as soon as some array
+        reaches beyond the end of the file.
+    */
+    struct Reader
+    {
+        const char* pos;
+        const char* end;
+        bool failed = false;
+    };
+
+    /**
+        Copies some values from the file to the end of a vector and advances past them, like 'put' wrote them.
+
+        @param reader the position of reading
+        @param values the vector to append the values to
+        @param count the number of values
+        @return false if the file ended before the values
+    */
+    template<typename Value>
+    bool get(Reader& reader, std::vector<Value>& values, size_t count)
+    {
+        size_t size = count*sizeof(Value);
+        size_t padded = size + (8 - size % 8) % 8;
+        if (reader.failed or count > static_cast<size_t>(reader.end - reader.pos) / sizeof(Value)
+            or padded > static_cast<size_t>(reader.end - reader.pos))
+        {
+            reader.failed = true;
+            return false;
+        }
+        size_t first = values.size();
+        values.resize(first + count);
+        if (size > 0) { std::memcpy(values.data() + first, reader.pos, size); }
+        reader.pos += padded;
+        return true;
+    }
+
+    /**
+        Reads one number from the file and advances past it.
+
+        @param reader the position of reading
+        @param number this will store the number
+        @return false if the file ended before the number
+    */
+    bool get(Reader& reader, uint64_t& number)
+    {
+        std::vector<uint64_t> numbers;
+        if (not get(reader, numbers, 1)) { return false; }
+        number = numbers[0];
+        return true;
+    }
+
+    /**
+        Tests whether the offsets of some parts of an array start at 0, never decrease and end at the array's size.
+
+        @param offsets the offsets, one more than parts
+        @param size the size of the array
+        @return true if the offsets are valid
+    */
+    bool valid(const std::vector<uint64_t>& offsets, size_t size)
+    {
+        if (offsets.empty() or offsets.front() != 0 or offsets.back() != size) { return false; }
+        return std::is_sorted(offsets.begin(), offsets.end());
+    }
+
+    /**
+        Tests whether some bytes start with the header of this format, whatever the kind of features.
+
+        @param begin the beginning of the bytes
+        @param end the end of the bytes
+        @return true if the bytes look like a file of this format
+    */
+    bool is(const char* begin, const char* end)
+    {
+        uint64_t magic;
+        if (static_cast<size_t>(end - begin) < sizeof(magic)) { return false; }
+        std::memcpy(&magic, begin, sizeof(magic));
+        return magic == MAGIC;
+    }
+
+    /**
+        Writes a buffer followed by its checksum to a file, first under a temporary name
+        which is then renamed, so that readers never see a partly written file.
+
+        @param path path to the file
+        @param buffer the contents of the file before the checksum
+        @return false if the file could not be written
+    */
+    bool write(const std::string& path, std::string& buffer)
+    {
+        put(buffer, checksum(buffer.data(), buffer.size()));
+
+        std::string temporary = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream stream {temporary, std::ios::binary | std::ios::trunc};
+            stream.write(buffer.data(), buffer.size());
+            stream.close();
+            if (not stream)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+        Starts reading a file of this format: checks its checksum, magic number, version and kind of features.
+
+        @param begin the beginning of the file's contents
+        @param end the end of the file's contents
+        @param kind the expected kind of features
+        @return the position of reading after the header, which has failed if the file is not valid
+    */
+    Reader open(const char* begin, const char* end, uint64_t kind)
+    {
+        Reader reader {begin, end};
+        uint64_t stored;
+        if (static_cast<size_t>(end - begin) < 4*sizeof(stored) or (end - begin) % 8 != 0)
+        {
+            reader.failed = true;
+            return reader;
+        }
+        reader.end = end - sizeof(stored);
+        std::memcpy(&stored, reader.end, sizeof(stored));
+
+        uint64_t magic = 0, version = 0, file_kind = 0;
+        get(reader, magic);
+        get(reader, version);
+        get(reader, file_kind);
+        if (stored != checksum(begin, reader.end - begin) or magic != MAGIC or version != VERSION or file_kind != kind)
+        {
+            reader.failed = true;
+        }
+        return reader;
+    }
+
+    /**
+        Writes all region features of a store to a file. Each array is written as a whole: the mesh ids,
+        the raw population by column, the boxes, the offsets of the polygons and all their points. Region
+        features which have no region in the store, as they were outside the routes' boundary, have no polygon.
+
+        @param path path to the file
+        @param store the store with the region features
+        @return false if the file could not be written
+    */
+    bool save_regions(const std::string& path, const store::Store& store)
+    {
+        size_t features = store.region_features;
+        std::vector<int32_t> mesh_ids(features, -1);
+        std::vector<intersection::Box> boxes(features, intersection::Box{intersection::supremum, intersection::infimum});
+        std::vector<uint64_t> offsets {0};
+        std::vector<intersection::Point> points;
+        for (size_t f = 0, r = 0; f < features; ++f)
+        {
+            if (r < store.ordinals.size() and store.ordinals[r] == f)
+            {
+                mesh_ids[f] = store.mesh_ids[r];
+                boxes[f] = store.region_boxes[r];
+                const store::Span& polygon = store.polygons[r];
+                points.insert(points.end(), store.points.begin() + polygon.offset, store.points.begin() + polygon.offset + polygon.length);
+                ++r;
+            }
+            offsets.push_back(points.size());
+        }
+
+        std::string buffer;
+        put(buffer, MAGIC);
+        put(buffer, VERSION);
+        put(buffer, REGIONS);
+        put(buffer, features);
+        put(buffer, points.size());
+        put(buffer, mesh_ids.data(), features);
+        for (const auto& column : store.population) { put(buffer, column.data(), features); }
+        put(buffer, boxes.data(), features);
+        put(buffer, offsets.data(), offsets.size());
+        put(buffer, points.data(), points.size());
+        return write(path, buffer);
+    }
+
+    /**
+        Adds the region features of a file of this format to the store, like parse::all_regions adds the features
+        of a GeoJSON file. The targets of the regions are computed from their raw population by store::targets.
+
+        @param store the store to add the regions to
+        @param begin the beginning of the file's contents
+        @param end the end of the file's contents
+        @param target_ages contains the target age groups
+        @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
+        @param routes_boundary the box containing all the route polylines
+        @return false if the file is not a valid file of region features, then the store is unchanged
+    */
+    bool regions(
+        store::Store& store,
+        const char* begin,
+        const char* end,
+        const std::string& target_ages,
+        const std::array<double, intersection::TIMESLOTS>& active_factors,
+        const intersection::Box& routes_boundary)
+    {
+        Reader reader = open(begin, end, REGIONS);
+        uint64_t features = 0, size = 0;
+        get(reader, features);
+        get(reader, size);
+
+        store::Store part;
+        std::vector<int32_t> mesh_ids;
+        std::vector<intersection::Box> boxes;
+        std::vector<uint64_t> offsets;
+        std::vector<intersection::Point> points;
+        get(reader, mesh_ids, features);
+        for (auto& column : part.population) { get(reader, column, features); }
+        get(reader, boxes, features);
+        get(reader, offsets, features + 1);
+        get(reader, points, size);
+        if (reader.failed or reader.pos != reader.end or not valid(offsets, size)) { return false; }
+
+        part.region_features = features;
+        auto targets = store::targets(part, target_ages, active_factors);
+        for (size_t f = 0; f < features; ++f)
+        {
+            if (not intersection::may(boxes[f], routes_boundary)) { continue; }
+            part.ordinals.push_back(f);
+            part.mesh_ids.push_back(mesh_ids[f]);
+            part.region_targets.push_back(targets[f]);
+            part.region_boxes.push_back(boxes[f]);
+
+            part.polygons.push_back(store::Span{part.points.size(), offsets[f+1] - offsets[f]});
+            part.points.insert(part.points.end(), points.begin() + offsets[f], points.begin() + offsets[f+1]);
+            part.polygon_edges.push_back(store::Span{part.edges.c_x.size(), 0});
+            intersection::split(points.data() + offsets[f], offsets[f+1] - offsets[f], part.edges);
+            part.polygon_edges.back().length = part.edges.c_x.size() - part.polygon_edges.back().offset;
+        }
+        store::append(store, part);
+        return true;
+    }
+
+    /**
+        Writes all routes of a store to a file. Each array is written as a whole: the ids, numbers of buses,
+        costs and boxes of the routes, the offsets of their polylines, the offsets of the polylines' points, the
+        boxes of the polylines, the offsets of their chunks' boxes, all chunks' boxes and all points.
+
+        @param path path to the file
+        @param store the store with the routes
+        @return false if the file could not be written
+    */
+    bool save_routes(const std::string& path, const store::Store& store)
+    {
+        size_t routes = store.output_ids.size();
+        std::vector<int32_t> output_ids(store.output_ids.begin(), store.output_ids.end());
+        std::vector<int32_t> buses;
+        std::vector<uint64_t> route_offsets {0};
+        std::vector<uint64_t> point_offsets {0};
+        std::vector<uint64_t> chunk_offsets {0};
+        std::vector<intersection::Box> polyline_boxes;
+        std::vector<intersection::Box> chunk_boxes;
+        std::vector<intersection::Point> points;
+        for (size_t r = 0; r < routes; ++r)
+        {
+            buses.insert(buses.end(), store.buses[r].begin(), store.buses[r].end());
+            const store::Span& lines = store.route_polylines[r];
+            for (size_t p = lines.offset; p < lines.offset + lines.length; ++p)
+            {
+                const store::Span& polyline = store.polylines[p];
+                points.insert(points.end(), store.points.begin() + polyline.offset, store.points.begin() + polyline.offset + polyline.length);
+                point_offsets.push_back(points.size());
+
+                const store::Span& chunks = store.polyline_chunks[p];
+                chunk_boxes.insert(chunk_boxes.end(), store.chunk_boxes.begin() + chunks.offset, store.chunk_boxes.begin() + chunks.offset + chunks.length);
+                chunk_offsets.push_back(chunk_boxes.size());
+                polyline_boxes.push_back(store.polyline_boxes[p]);
+            }
+            route_offsets.push_back(polyline_boxes.size());
+        }
+
+        std::string buffer;
+        put(buffer, MAGIC);
+        put(buffer, VERSION);
+        put(buffer, ROUTES);
+        put(buffer, routes);
+        put(buffer, polyline_boxes.size());
+        put(buffer, chunk_boxes.size());
+        put(buffer, points.size());
+        put(buffer, output_ids.data(), routes);
+        put(buffer, buses.data(), buses.size());
+        put(buffer, store.costs.data(), routes);
+        put(buffer, store.route_boxes.data(), routes);
+        put(buffer, route_offsets.data(), route_offsets.size());
+        put(buffer, point_offsets.data(), point_offsets.size());
+        put(buffer, polyline_boxes.data(), polyline_boxes.size());
+        put(buffer, chunk_offsets.data(), chunk_offsets.size());
+        put(buffer, chunk_boxes.data(), chunk_boxes.size());
+        put(buffer, points.data(), points.size());
+        return write(path, buffer);
+    }
+
+    /**
+        Adds the routes of a file of this format to the store, like parse::all_routes adds the features
+        of a GeoJSON file, with the same box hierarchy of their polylines.
+
+        @param store the store to add the routes to
+        @param begin the beginning of the file's contents
+        @param end the end of the file's contents
+        @return false if the file is not a valid file of routes, then the store is unchanged
+    */
+    bool routes(store::Store& store, const char* begin, const char* end)
+    {
+        Reader reader = open(begin, end, ROUTES);
+        uint64_t routes = 0, polylines = 0, chunks = 0, size = 0;
+        get(reader, routes);
+        get(reader, polylines);
+        get(reader, chunks);
+        get(reader, size);
+
+        store::Store part;
+        std::vector<int32_t> output_ids;
+        std::vector<int32_t> buses;
+        std::vector<uint64_t> route_offsets;
+        std::vector<uint64_t> point_offsets;
+        std::vector<uint64_t> chunk_offsets;
+        get(reader, output_ids, routes);
+        get(reader, buses, routes * intersection::TIMESLOTS);
+        get(reader, part.costs, routes);
+        get(reader, part.route_boxes, routes);
+        get(reader, route_offsets, routes + 1);
+        get(reader, point_offsets, polylines + 1);
+        get(reader, part.polyline_boxes, polylines);
+        get(reader, chunk_offsets, polylines + 1);
+        get(reader, part.chunk_boxes, chunks);
+        get(reader, part.points, size);
+        if (reader.failed or reader.pos != reader.end or not valid(route_offsets, polylines)
+            or not valid(point_offsets, size) or not valid(chunk_offsets, chunks))
+        {
+            return false;
+        }
+
+        for (size_t r = 0; r < routes; ++r)
+        {
+            part.output_ids.push_back(output_ids[r]);
+            part.buses.push_back({buses[r*3], buses[r*3 + 1], buses[r*3 + 2]});
+            part.route_targets.push_back({0., 0., 0.});
+            part.route_polylines.push_back(store::Span{route_offsets[r], route_offsets[r+1] - route_offsets[r]});
+
+            auto maxBuses = std::max({buses[r*3], buses[r*3 + 1], buses[r*3 + 2], 0});
+            part.route_benefits.push_back(store::Span{part.benefits.size(), static_cast<size_t>(maxBuses)});
+            part.benefits.resize(part.benefits.size() + maxBuses, 0.0);
+        }
+        for (size_t p = 0; p < polylines; ++p)
+        {
+            part.polylines.push_back(store::Span{point_offsets[p], point_offsets[p+1] - point_offsets[p]});
+            part.polyline_chunks.push_back(store::Span{chunk_offsets[p], chunk_offsets[p+1] - chunk_offsets[p]});
+        }
+        store::append(store, part);
+        return true;
+    }
+}
@@ -21,6 +21,444 @@ namespace knapsack
         return x;
     }
 
+    /**
+        Represents the dynamic programming table of the Knapsack problem. Budgets are measured in
+        integer units of the greatest common divisor of all route costs, so that every budget
+        we ever look at is an exact column index. The values are stored in one contiguous
+        row-major buffer with one row per route and one column per budget unit.
+    */
+    struct Table
+    {
+        double unit = 1.0;
+        size_t columns = 0;
+        size_t rows = 0;
+        std::vector<double> values;
+
+        /**
+            Returns the maximum achievable value considering only items up to the 'row' item
+            and using up to 'column' budget units.
+
+            @param row index of the last considered route
+            @param column budget in units
+            @return maximum achievable value
+        */
+        double at(size_t row, size_t column) const
+        {
+            return values[row*columns + column];
+        }
+    };
+
+    /**
+        Converts an amount of money into budget units, rounding down.
+
+        @param amount the amount of money
+        @param cost_gcd the greatest common divisor of all route costs
+        @return the number of whole budget units the amount buys
+    */
+    size_t units(double amount, double cost_gcd)
+    {
+        if (amount < 0.0 or cost_gcd <= 0.0) { return 0; }
+        return static_cast<size_t>(std::floor(amount / cost_gcd));
+    }
+
+    /**
+        The max-plus kernel updates a block of budget cells at once: target[i] becomes the maximum of
+        target[i] and source[i] + value for all i below count. The source and target must not overlap.
+    */
+    typedef void (*Kernel)(const double* source, double value, double* target, size_t count);
+
+    /**
+        Max-plus kernel working on one budget cell at a time. It runs on every processor.
+
+        @param source the cells of the previous row we add the value to
+        @param value the value to add
+        @param target the cells of the current row to update
+        @param count the number of cells
+    */
+    void maxplus_scalar(const double* source, double value, double* target, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto countValue = source[i] + value;
+            if (countValue > target[i]) { target[i] = countValue; }
+        }
+    }
+
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+    /**
+        Max-plus kernel working on four budget cells at a time with AVX2 instructions. It must only
+        be called on processors supporting AVX2.
+
+        @param source the cells of the previous row we add the value to
+        @param value the value to add
+        @param target the cells of the current row to update
+        @param count the number of cells
+    */
+    __attribute__((target("avx2")))
+    void maxplus_avx2(const double* source, double value, double* target, size_t count)
+    {
+        const __m256d values = _mm256_set1_pd(value);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m256d countValues = _mm256_add_pd(_mm256_loadu_pd(source + i), values);
+            _mm256_storeu_pd(target + i, _mm256_max_pd(_mm256_loadu_pd(target + i), countValues));
+        }
+        knapsack::maxplus_scalar(source + i, value, target + i, count - i);
+    }
+#endif
+
+    /**
+        Picks the fastest max-plus kernel the processor supports, once.
+
+        @return the picked kernel
+    */
+    Kernel kernel()
+    {
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+        static const Kernel picked = __builtin_cpu_supports("avx2") ? maxplus_avx2 : maxplus_scalar;
+#else
+        static const Kernel picked = maxplus_scalar;
+#endif
+        return picked;
+    }
+
+    /**
+        Computes the cells [begin, end) of one row of the table from the previous row, that is, the
+        maximum values for these budgets when the given route is added to the items considered so far.
+
+        The value for some budget is the maximum over the value of taking none of this item type, which is
+        the previous row's value for the same budget, and the values of taking t+1 buses, which are the
+        previous row's values for a budget smaller by t+1 costs plus the benefit of t+1 buses. So for
+        each number of buses, we shift the previous row and update the whole range with one kernel call.
+        The maximum does not depend on the order of the comparisons, so this gives the same values as
+        looking at one budget after another.
+
+        @param route the route added in this row
+        @param cost_units the cost of one bus on this route in budget units
+        @param previous the previous row
+        @param current the row to compute
+        @param begin the first budget unit to compute
+        @param end one past the last budget unit to compute
+        @param kernel the max-plus kernel updating blocks of cells
+    */
+    void cells(
+        const intersection::Route& route,
+        size_t cost_units,
+        const double* previous,
+        double* current,
+        size_t begin,
+        size_t end,
+        Kernel kernel)
+    {
+        // this is the value we get when taking none of this item type
+        std::copy(previous + begin, previous + end, current + begin);
+
+        // route.benefits[take_index] is the benefit of buying take_index+1 buses
+        size_t take_units = 0;
+        for (size_t take_index = 0; take_index < route.benefits.size(); ++take_index)
+        {
+            take_units += cost_units;
+            if (take_units >= end) { break; }
+            size_t first = std::max(begin, take_units);
+            kernel(previous + first - take_units, route.benefits[take_index], current + first, end - first);
+        }
+    }
+
+    /**
+        Tells whether the benefits of a route are concave in the number of buses, that is, whether
+        every additional bus adds at most as much as the one before it. This holds for all benefits
+        computed by store::all, up to rounding.
+
+        @param route the route to check
+        @return true if the benefits are concave
+    */
+    bool concave(const intersection::Route& route)
+    {
+        double before = std::numeric_limits<double>::infinity();
+        double last = 0.0;
+        for (auto benefit : route.benefits)
+        {
+            double gain = benefit - last;
+            if (gain > before) { return false; }
+            before = gain;
+            last = benefit;
+        }
+        return true;
+    }
+
+    /**
+        Computes the cells r + m*cost_units for m in [first, last] of a row where the route's benefits
+        are concave, knowing that the best number of buses for these cells leaves a remaining budget of
+        r + i*cost_units with i in [low, high].
+
+        For concave benefits, the cells with the same remainder modulo the cost form a max-plus
+        convolution of the previous row with a concave function. There, the remaining budget of the best
+        choice (the greatest one among equally good choices) never decreases when the budget increases.
+        So we find the best choice for the middle cell by trying all candidates, and then search the
+        cells to its left only up to that choice and the cells to its right only from that choice on.
+        This looks at O((m + k) log m) candidates instead of O(mk) for m cells and k buses.
+
+        @param route the route added in this row
+        @param cost_units the cost of one bus on this route in budget units
+        @param previous the previous row
+        @param current the row to compute
+        @param r the remainder of the budget units of the computed cells modulo the cost
+        @param first the smallest cell index m
+        @param last the greatest cell index m
+        @param low the smallest possible i
+        @param high the greatest possible i
+    */
+    void concave_cells(
+        const intersection::Route& route,
+        size_t cost_units,
+        const double* previous,
+        double* current,
+        size_t r,
+        size_t first,
+        size_t last,
+        size_t low,
+        size_t high)
+    {
+        const size_t buses = route.benefits.size();
+        size_t m = first + (last - first)/2;
+        size_t from = std::max(low, m > buses ? m - buses : 0);
+        size_t to = std::min(high, m);
+        if (from > to)
+        {
+            from = m > buses ? m - buses : 0;
+            to = m;
+        }
+
+        // this is the value we get when taking none of this item type
+        size_t best = to;
+        double max_value = to == m ? previous[r + m*cost_units]
+            : previous[r + to*cost_units] + route.benefits[m - to - 1];
+        for (size_t i = to; i-- > from;)
+        {
+            // route.benefits[m-i-1] is the benefit of buying m-i buses
+            double countValue = previous[r + i*cost_units] + route.benefits[m - i - 1];
+            if (countValue > max_value)
+            {
+                max_value = countValue;
+                best = i;
+            }
+        }
+        current[r + m*cost_units] = max_value;
+
+        if (m > first) { knapsack::concave_cells(route, cost_units, previous, current, r, first, m-1, low, best); }
+        if (m < last) { knapsack::concave_cells(route, cost_units, previous, current, r, m+1, last, best, high); }
+    }
+
+    /**
+        Computes the cells [begin, end) of one row of the table like 'cells', but only for routes with
+        concave benefits, going through the budgets with the same remainder modulo the cost one after another.
+
+        @param route the route added in this row
+        @param cost_units the cost of one bus on this route in budget units, which must be positive
+        @param previous the previous row
+        @param current the row to compute
+        @param begin the first budget unit to compute
+        @param end one past the last budget unit to compute
+    */
+    void concave_cells(
+        const intersection::Route& route,
+        size_t cost_units,
+        const double* previous,
+        double* current,
+        size_t begin,
+        size_t end)
+    {
+        for (size_t cell = begin; cell < end and cell < begin + cost_units; ++cell)
+        {
+            size_t r = cell % cost_units;
+            size_t first = cell / cost_units;
+            size_t last = (end - 1 - r) / cost_units;
+            knapsack::concave_cells(route, cost_units, previous, current, r, first, last, 0, last);
+        }
+    }
+
+    /**
+        Computes one row of the table from the previous row, that is, the maximum values for all budgets
+        when the given route is added to the items considered so far.
+
+        For routes with many buses and concave benefits, we use the faster 'concave_cells' instead of
+        trying every number of buses for every budget. With few buses, trying all of them is faster.
+
+        Every cell of a row only reads the previous row, so with a pool of threads, we split the row
+        into blocks of budgets and compute them in parallel. This gives exactly the same values.
+
+        @param route the route added in this row
+        @param cost_units the cost of one bus on this route in budget units
+        @param previous the previous row, or nullptr for the first row
+        @param current the row to compute
+        @param columns the number of budget units in a row
+        @param workers the threads to compute the blocks of a row on, or nullptr to stay on this thread
+        @param kernel the max-plus kernel updating blocks of cells
+    */
+    void layer(
+        const intersection::Route& route,
+        size_t cost_units,
+        const double* previous,
+        double* current,
+        size_t columns,
+        pool::Pool* workers = nullptr,
+        Kernel kernel = knapsack::kernel())
+    {
+        static const size_t block = 1 << 14;
+        static const size_t concave_buses = 32;
+
+        std::vector<double> zeros;
+        if (!previous)
+        {
+            zeros.assign(columns, 0.0);
+            previous = zeros.data();
+        }
+
+        bool use_concave = cost_units > 0 and route.benefits.size() >= concave_buses and knapsack::concave(route);
+        auto compute = [&](size_t begin, size_t end)
+        {
+            if (use_concave) { knapsack::concave_cells(route, cost_units, previous, current, begin, end); }
+            else { knapsack::cells(route, cost_units, previous, current, begin, end, kernel); }
+        };
+
+        if (!workers or workers->size() == 1 or columns < 2*block)
+        {
+            compute(0, columns);
+            return;
+        }
+
+        size_t blocks = (columns + block - 1) / block;
+        workers->run(blocks, [&](size_t b)
+        {
+            compute(b*block, std::min(columns, (b+1)*block));
+        });
+    }
+
+    /**
+        Finds how many buses of the given route an optimal allocation buys, given the row of this
+        route and the row before it. This is one step of walking back through the table.
+
+        @param route the route of the current row
+        @param cost_units the cost of one bus on this route in budget units
+        @param previous the previous row, or nullptr for the first row
+        @param current the row of this route
+        @param cur_units the remaining budget in units, which is reduced by the cost of the taken buses
+        @return the number of buses to buy on this route
+    */
+    int take(
+        const intersection::Route& route,
+        size_t cost_units,
+        const double* previous,
+        const double* current,
+        size_t& cur_units)
+    {
+        // this is the value we want to reach
+        auto max_value = current[cur_units];
+
+        // this is the value we get when taking none of this item type
+        auto countValue = previous ? previous[cur_units] : 0.0;
+
+        // now we want to figure out how many of this item type we need to reach the maximum value
+        int takeCount = 0;
+        while (max_value > countValue)
+        {
+            cur_units -= cost_units; // this must not underflow because max_value is reachable
+            countValue = previous ? previous[cur_units] : 0.0;
+            countValue += route.benefits[takeCount];
+            ++takeCount;
+        }
+        return takeCount;
+    }
+
+    /**
+        Fills the dynamic programming table for all budgets up to the given total budget.
+
+        For each pair (budget, item), the table holds the maximum number of targets reachable with that
+        money and only using items that are to the left of 'item' in the order in which we read them.
+
+        @param routes the vector with the routes, our items
+        @param total_budget the total given budget
+        @param cost_gcd the greatest common divisor of all route costs
+        @param table the table to fill
+        @param workers the threads to compute the rows on, or nullptr to stay on this thread
+    */
+    void solve(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const double& total_budget,
+        const double& cost_gcd,
+        Table& table,
+        pool::Pool* workers = nullptr)
+    {
+        table.unit = cost_gcd;
+        table.rows = routes.size();
+        table.columns = knapsack::units(total_budget, cost_gcd) + 1;
+        table.values.assign(table.rows*table.columns, 0.0);
+
+        for (size_t first = 0; first < table.rows; ++first)
+        {
+            auto& route = routes[first];
+            auto cost_units = knapsack::units(route->cost, cost_gcd);
+            const double* previous = first > 0 ? &table.values[(first-1)*table.columns] : nullptr;
+            double* current = &table.values[first*table.columns];
+
+            knapsack::layer(*route, cost_units, previous, current, table.columns, workers);
+        }
+    }
+
+    /**
+        Reconstructs an optimal allocation for the given budget from a filled table. The budget
+        may be anything up to the total budget the table was filled for.
+
+        @param table the filled table
+        @param routes the vector with the routes, our items
+        @param budget_units the budget in units
+        @param allocation our optimal route allocation
+        @return the number of targets this allocation will, on expectation, reach
+    */
+    double allocate(
+        const Table& table,
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        size_t budget_units,
+        std::map<int, int>& allocation)
+    {
+        if (table.rows == 0) { return 0.0; }
+
+        size_t cur_units = std::min(budget_units, table.columns-1);
+        double solution_value = table.at(table.rows-1, cur_units);
+        for (int last = table.rows-1; last >= 0; --last)
+        {
+            auto& route = routes[last];
+            const double* previous = last > 0 ? &table.values[(last-1)*table.columns] : nullptr;
+            int takeCount = knapsack::take(*route, knapsack::units(route->cost, table.unit),
+                previous, &table.values[last*table.columns], cur_units);
+            if (takeCount > 0) { allocation[route->outputId] = takeCount; }
+        }
+
+        return solution_value;
+    }
+
+    /**
+        Reads the budget-to-value curve off a filled table. The last row holds the maximum value for
+        every budget up to the total budget, and since this value only changes at some budgets,
+        we only keep the points where it increases, starting at budget zero. The value for any
+        other budget is the value of the nearest point to its left.
+
+        @param table the filled table
+        @param curve this will store the pairs (budget, maximum value) where the value increases
+    */
+    void frontier(const Table& table, std::vector<std::pair<double, double>>& curve)
+    {
+        curve.emplace_back(0.0, 0.0);
+        if (table.rows == 0) { return; }
+
+        for (size_t cur_units = 0; cur_units < table.columns; ++cur_units)
+        {
+            double value = table.at(table.rows-1, cur_units);
+            if (value > curve.back().second) { curve.emplace_back(cur_units*table.unit, value); }
+        }
+    }
+
     /**
         Finds an optimal allocation of wrapping buses through dynamic programming.
 
@@ -45,13 +483,15 @@ namespace knapsack
         all these values and their maximum is the maximum value of having budget B considerung all items up to I.
 
         The main trick here to reduce running time is to use the greatest common divisor of all
-        costs of routes.
+        costs of routes: budgets are counted in whole multiples of it, so that the table is a dense
+        array indexed by integers instead of a map keyed by floating budgets.
 
         @param routes the vector with the routes, our items
         @param total_budget the total given budget
         @param min_cost the minimum cost across all routes
         @param cost_gcd the greatest common divisor of all route costs
         @param allocation our optimal route allocation
+        @param workers the threads to compute the rows on, or nullptr to stay on this thread
         @return the number of targets this allocation will, on expectation, reach
     */
     double optimize(
@@ -59,72 +499,579 @@ namespace knapsack
         const double& total_budget,
         const double& min_cost,
         const double& cost_gcd,
+        std::map<int, int>& allocation,
+        pool::Pool* workers = nullptr)
+    {
+        if (routes.empty() or total_budget < min_cost)
+        {
+            std::clog << "Not enough total budget to buy any wrapping bus" << std::endl;
+            return 0.0;
+        }
+
+        Table table;
+        knapsack::solve(routes, total_budget, cost_gcd, table, workers);
+        return knapsack::allocate(table, routes, table.columns-1, allocation);
+    }
+
+    /**
+        Keeps track of the working memory a solver holds for its rows, in bytes.
+    */
+    struct Memory
+    {
+        size_t current = 0;
+        size_t peak = 0;
+
+        void add(size_t bytes)
+        {
+            current += bytes;
+            if (current > peak) { peak = current; }
+        }
+
+        void remove(size_t bytes)
+        {
+            current -= bytes;
+        }
+    };
+
+    /**
+        Computes the last row of the table for the routes with indices in [begin, end) alone, adding them
+        from the first to the last or from the last to the first. Both give the maximum value of these
+        routes for every budget, only two rows are held at a time.
+
+        @param routes the vector with the routes, our items
+        @param cost_gcd the greatest common divisor of all route costs
+        @param columns the number of budget units in a row
+        @param begin the index of the first route
+        @param end one past the index of the last route
+        @param backward whether to add the routes from the last to the first
+        @param row this will store the values of the last row
+        @param memory this will keep track of the held rows
+        @param workers the threads to compute the rows on, or nullptr to stay on this thread
+    */
+    void last_row(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const double& cost_gcd,
+        size_t columns,
+        size_t begin,
+        size_t end,
+        bool backward,
+        std::vector<double>& row,
+        Memory& memory,
+        pool::Pool* workers)
+    {
+        const size_t bytes = columns*sizeof(double);
+        std::vector<double> spare(columns);
+        memory.add(bytes);
+        row.assign(columns, 0.0);
+        for (size_t r = begin; r < end; ++r)
+        {
+            auto& route = routes[backward ? end - 1 - (r - begin) : r];
+            knapsack::layer(*route, knapsack::units(route->cost, cost_gcd), r > begin ? row.data() : nullptr,
+                spare.data(), columns, workers);
+            row.swap(spare);
+        }
+        memory.remove(bytes);
+    }
+
+    /**
+        Finds how many buses an optimal allocation buys on the routes with indices in [begin, end) with
+        the given budget, like Hirschberg's algorithm for sequence alignments. The last row of the first half
+        of the routes and the last row of the second half, added backwards, give the best value of each half
+        for every budget, so the best split of the budget between the halves is the one maximizing their sum.
+        Then we go on in both halves with their parts of the budget. So at any time, we hold the rows of one
+        level of recursion only, and the levels take half as long as the one before them.
+
+        @param routes the vector with the routes, our items
+        @param cost_gcd the greatest common divisor of all route costs
+        @param begin the index of the first route
+        @param end one past the index of the last route
+        @param cur_units the budget of these routes in units
+        @param allocation this will store the buses bought on these routes
+        @param memory this will keep track of the held rows
+        @param workers the threads to compute the rows on, or nullptr to stay on this thread
+    */
+    void split_rows(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const double& cost_gcd,
+        size_t begin,
+        size_t end,
+        size_t cur_units,
+        std::map<int, int>& allocation,
+        Memory& memory,
+        pool::Pool* workers)
+    {
+        const size_t columns = cur_units + 1;
+        const size_t bytes = columns*sizeof(double);
+
+        if (end - begin == 1)
+        {
+            auto& route = routes[begin];
+            std::vector<double> row;
+            memory.add(bytes);
+            knapsack::last_row(routes, cost_gcd, columns, begin, end, false, row, memory, workers);
+            int takeCount = knapsack::take(*route, knapsack::units(route->cost, cost_gcd), nullptr, row.data(), cur_units);
+            if (takeCount > 0) { allocation[route->outputId] = takeCount; }
+            memory.remove(bytes);
+            return;
+        }
+
+        size_t middle = begin + (end - begin)/2;
+        size_t split = 0;
+        {
+            std::vector<double> first;
+            std::vector<double> second;
+            memory.add(2*bytes);
+            knapsack::last_row(routes, cost_gcd, columns, begin, middle, false, first, memory, workers);
+            knapsack::last_row(routes, cost_gcd, columns, middle, end, true, second, memory, workers);
+
+            // among equal splits, the second half gets the least budget; where several allocations tie, the
+            // halves may still pick another one of them than walking back through the table would
+            double max_value = -1.0;
+            for (size_t units = 0; units <= cur_units; ++units)
+            {
+                double value = first[units] + second[cur_units - units];
+                if (value >= max_value)
+                {
+                    max_value = value;
+                    split = units;
+                }
+            }
+            memory.remove(2*bytes);
+        }
+
+        knapsack::split_rows(routes, cost_gcd, begin, middle, split, allocation, memory, workers);
+        knapsack::split_rows(routes, cost_gcd, middle, end, cur_units - split, allocation, memory, workers);
+    }
+
+    /**
+        Finds an optimal allocation of wrapping buses like 'optimize', but without keeping the whole
+        table in memory: 'split_rows' splits the budget between the halves of the routes from a few rows
+        and goes on in each half. This takes about three times as long as filling the table once, but the working
+        memory grows with the number of budget units only, not with the number of routes. The value is the
+        same as that of 'optimize', but where several allocations reach it, the allocation may differ.
+
+        @param routes the vector with the routes, our items
+        @param total_budget the total given budget
+        @param min_cost the minimum cost across all routes
+        @param cost_gcd the greatest common divisor of all route costs
+        @param allocation our optimal route allocation
+        @param memory this will keep track of the working memory
+        @param workers the threads to compute the rows on, or nullptr to stay on this thread
+        @return the number of targets this allocation will, on expectation, reach
+    */
+    double optimize_linear(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const double& total_budget,
+        const double& min_cost,
+        const double& cost_gcd,
+        std::map<int, int>& allocation,
+        Memory& memory,
+        pool::Pool* workers = nullptr)
+    {
+        if (routes.empty() or total_budget < min_cost)
+        {
+            std::clog << "Not enough total budget to buy any wrapping bus" << std::endl;
+            return 0.0;
+        }
+
+        // the value is read off the last row added in the order of the table, so it is the same to the bit
+        const size_t cur_units = knapsack::units(total_budget, cost_gcd);
+        double solution_value = 0.0;
+        {
+            std::vector<double> row;
+            memory.add((cur_units + 1)*sizeof(double));
+            knapsack::last_row(routes, cost_gcd, cur_units + 1, 0, routes.size(), false, row, memory, workers);
+            solution_value = row[cur_units];
+            memory.remove((cur_units + 1)*sizeof(double));
+        }
+
+        knapsack::split_rows(routes, cost_gcd, 0, routes.size(), cur_units, allocation, memory, workers);
+        return solution_value;
+    }
+
+    /**
+        Computes the minimum cost of reaching every rounded value up to some limit with the routes
+        items[begin] to items[end-1], buying some number of buses of each of them. The benefit of
+        a number of buses is rounded down to a multiple of the scale, and costs above the total budget
+        count as unreachable.
+
+        @param routes the vector with the routes
+        @param items the indices of the routes taking part
+        @param begin the index of the first item
+        @param end one past the index of the last item
+        @param scale the scale of the rounded values
+        @param total_budget the total given budget
+        @param limit the greatest rounded value
+        @param min_cost this will store the minimum cost of every rounded value, infinite if it cannot be reached
+    */
+    void cheapest(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const std::vector<size_t>& items,
+        size_t begin,
+        size_t end,
+        const double& scale,
+        const double& total_budget,
+        size_t limit,
+        std::vector<double>& min_cost)
+    {
+        min_cost.assign(limit + 1, std::numeric_limits<double>::infinity());
+        min_cost[0] = 0.0;
+        std::vector<double> next_cost;
+        size_t reached = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            auto& route = routes[items[i]];
+            next_cost = min_cost;
+            size_t next_reached = reached;
+            for (size_t t = 0; t < route->benefits.size() and (t+1)*route->cost <= total_budget; ++t)
+            {
+                double cost = (t+1)*route->cost;
+                size_t value = static_cast<size_t>(std::floor(route->benefits[t] / scale));
+                for (size_t v = 0; v <= reached and v + value <= limit; ++v)
+                {
+                    double countCost = min_cost[v] + cost;
+                    if (countCost < next_cost[v + value] and countCost <= total_budget)
+                    {
+                        next_cost[v + value] = countCost;
+                        next_reached = std::max(next_reached, v + value);
+                    }
+                }
+            }
+            min_cost.swap(next_cost);
+            reached = next_reached;
+        }
+    }
+
+    /**
+        Finds the numbers of buses of the routes items[begin] to items[end-1] reaching some rounded value
+        at the minimum cost, without a table of all choices. We compute the minimum costs of the first half
+        of the routes and of the second half up to the value, choose the split of the value whose costs
+        add up to the least, and go on in both halves with their parts of the value. So at any time we hold
+        only a few rows of costs, and every level of recursion takes at most as long as computing the costs once.
+
+        @param routes the vector with the routes
+        @param items the indices of the routes taking part
+        @param begin the index of the first item
+        @param end one past the index of the last item
+        @param scale the scale of the rounded values
+        @param total_budget the total given budget
+        @param value the rounded value to reach, which must be reachable
+        @param allocation this will store the numbers of buses of the routes
+        @return the benefit of the buses
+    */
+    double rebuild(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const std::vector<size_t>& items,
+        size_t begin,
+        size_t end,
+        const double& scale,
+        const double& total_budget,
+        size_t value,
         std::map<int, int>& allocation)
     {
-        double cur_budget = 0.0;
-        std::map<double, std::vector<double>> solution;
-        // solution[total_budget][first] is the maximum achievable value
-        // considering only items up to the 'first' item and using up to 'total_budget'
+        if (value == 0 or begin == end) { return 0.0; }
 
-        for (size_t first = 0, num_routes = routes.size(); first < num_routes; ++first)
+        if (end - begin == 1)
         {
-            auto& route = routes[first];
-            for (cur_budget = min_cost; cur_budget <= total_budget; cur_budget += cost_gcd)
+            auto& route = routes[items[begin]];
+            for (size_t t = 0; t < route->benefits.size() and (t+1)*route->cost <= total_budget; ++t)
             {
-                // this is the value we get when taking none of this item type
-                auto max_value = first > 0 ? solution[cur_budget][first-1] : 0.0;
+                if (static_cast<size_t>(std::floor(route->benefits[t] / scale)) == value)
+                {
+                    allocation[route->outputId] = t+1;
+                    return route->benefits[t];
+                }
+            }
+            return 0.0;
+        }
 
-                // we want to figure out how many of this item type we need to maximize the value
-                auto takeBudget {cur_budget};
-                for (size_t take_index = 0; take_index < route->benefits.size() && takeBudget >= route->cost; ++take_index)
+        size_t middle = begin + (end - begin)/2;
+        size_t split = 0;
+        {
+            std::vector<double> first;
+            std::vector<double> second;
+            knapsack::cheapest(routes, items, begin, middle, scale, total_budget, value, first);
+            knapsack::cheapest(routes, items, middle, end, scale, total_budget, value, second);
+            double least = std::numeric_limits<double>::infinity();
+            for (size_t v = 0; v <= value; ++v)
+            {
+                if (first[v] + second[value - v] < least)
                 {
-                    takeBudget -= route->cost;
-                    auto countValue = (first > 0 && takeBudget >= min_cost) ? solution[takeBudget][first-1] : 0.0;
-                    // route->benefits[take_index] is the benefit of buying take_index+1 buses
-                    countValue += route->benefits[take_index];
-                    if (countValue > max_value) { max_value = countValue; }
+                    least = first[v] + second[value - v];
+                    split = v;
                 }
+            }
+        }
+
+        return knapsack::rebuild(routes, items, begin, middle, scale, total_budget, split, allocation)
+            + knapsack::rebuild(routes, items, middle, end, scale, total_budget, value - split, allocation);
+    }
+
+    /**
+        Finds an allocation of wrapping buses whose value is at least (1 - epsilon) times the optimum,
+        in time polynomial in the number of routes and 1/epsilon, whatever the costs are.
+
+        The exact dynamic programming goes through all budgets in units of the greatest common divisor
+        of all costs, which is hopeless once that divisor is tiny. Here we go through values instead:
+        we round every benefit down to a multiple of some scale K and compute, for every rounded value,
+        the minimum cost of reaching it. The greatest rounded value affordable with the total budget
+        gives our allocation. Every route loses less than K by the rounding, so with n routes, our
+        allocation is worse than the optimum by less than nK. We choose K as epsilon/n times a lower bound L
+        on the optimum, so that we lose less than epsilon L. The number of rounded values is an upper bound U
+        on the optimum divided by K, that is, n/epsilon times U/L. We get L and U from a greedy allocation
+        by benefit per cost and from its fractional completion, and these are never more than a factor
+        of two apart, so this takes O(n^2 k/epsilon) time for routes with up to k buses. The buses of the
+        allocation are found again by 'rebuild', which keeps the memory at O(n/epsilon) for a logarithmic
+        factor in time.
+
+        @param routes the vector with the routes, our items
+        @param total_budget the total given budget
+        @param epsilon the allowed relative loss, between 0 and 1
+        @param allocation our approximate route allocation
+        @param upper_bound this will store an upper bound on the optimal value
+        @return the number of targets this allocation will, on expectation, reach
+    */
+    double approximate(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const double& total_budget,
+        const double& epsilon,
+        std::map<int, int>& allocation,
+        double& upper_bound)
+    {
+        // only the routes where we can afford at least one bus take part
+        std::vector<size_t> items;
+        double lower_bound = 0.0;
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            auto& route = routes[r];
+            if (route->benefits.empty() or route->cost > total_budget) { continue; }
+            items.push_back(r);
 
-                if (solution[cur_budget].size() == 0)
+            for (size_t t = 0; t < route->benefits.size() and (t+1)*route->cost <= total_budget; ++t)
+            {
+                lower_bound = std::max(lower_bound, route->benefits[t]);
+            }
+        }
+
+        // The points (t*cost, benefit of t buses) of a route have an upper concave hull. Its segments,
+        // taken by decreasing benefit per cost and the last one fractionally, give the optimum of the
+        // relaxed problem where we may buy parts of buses, which is an upper bound on our optimum.
+        // Taking only whole segments in that order gives an allocation, which is a lower bound.
+        struct Segment
+        {
+            double slope;
+            size_t item;
+            size_t from;
+            size_t to;
+        };
+        std::vector<Segment> segments;
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            auto& route = routes[items[i]];
+            auto value = [&route](size_t t) { return t > 0 ? route->benefits[t-1] : 0.0; };
+            std::vector<size_t> hull {0};
+            for (size_t t = 1; t <= route->benefits.size() and t*route->cost <= total_budget; ++t)
+            {
+                // drop the last hull point while it lies below the line from the one before it to t
+                while (hull.size() >= 2)
                 {
-                    solution[cur_budget].resize(num_routes, 0.0);
+                    size_t a = hull[hull.size()-2];
+                    size_t b = hull.back();
+                    if ((value(b) - value(a))*(t - a) > (value(t) - value(a))*(b - a)) { break; }
+                    hull.pop_back();
                 }
-                solution[cur_budget][first] = max_value;
+                hull.push_back(t);
+            }
+            for (size_t h = 1; h < hull.size(); ++h)
+            {
+                double cost = (hull[h] - hull[h-1])*route->cost;
+                double gain = value(hull[h]) - value(hull[h-1]);
+                if (gain <= 0.0) { break; }
+                segments.push_back({cost > 0.0 ? gain / cost : std::numeric_limits<double>::infinity(), i, hull[h-1], hull[h]});
             }
         }
+        std::stable_sort(segments.begin(), segments.end(),
+            [](const Segment& x, const Segment& y) { return x.slope > y.slope; });
 
-        cur_budget -= cost_gcd;
-        if (solution.count(cur_budget) == 0)
+        upper_bound = 0.0;
+        double remaining = total_budget;
+        bool broken = false;
+        double greedy_value = 0.0;
+        double greedy_remaining = total_budget;
+        std::vector<size_t> level(items.size(), 0);
+        for (const auto& segment : segments)
         {
-            std::clog << "Not enough total budget to buy any wrapping bus" << std::endl;
-            return 0.0;
+            auto& route = routes[items[segment.item]];
+            double cost = (segment.to - segment.from)*route->cost;
+            double gain = route->benefits[segment.to-1] - (segment.from > 0 ? route->benefits[segment.from-1] : 0.0);
+            if (not broken)
+            {
+                if (cost <= remaining) { upper_bound += gain; remaining -= cost; }
+                else { upper_bound += gain*remaining/cost; broken = true; }
+            }
+            if (level[segment.item] == segment.from and cost <= greedy_remaining)
+            {
+                greedy_value += gain;
+                greedy_remaining -= cost;
+                level[segment.item] = segment.to;
+            }
         }
+        lower_bound = std::max(lower_bound, greedy_value);
 
-        double solution_value = solution[cur_budget][routes.size()-1];
-        // at the moment, cur_budget is the biggest key of solution
-        // now we allocate the items to achieve the maximum solution_value
-        for (int last = routes.size()-1; last >= 0 && cur_budget >= min_cost; --last)
+        if (items.empty() or lower_bound <= 0.0)
         {
-            // this is the value we want to reach
-            auto max_value = solution[cur_budget][last];
+            std::clog << "Not enough total budget to buy any useful wrapping bus" << std::endl;
+            upper_bound = 0.0;
+            return 0.0;
+        }
+
+        const double scale = epsilon * lower_bound / items.size();
+        const size_t max_value = static_cast<size_t>(std::floor(upper_bound / scale)) + 1;
+
+        std::vector<double> min_cost;
+        knapsack::cheapest(routes, items, 0, items.size(), scale, total_budget, max_value, min_cost);
+        size_t value = max_value;
+        while (min_cost[value] > total_budget) { --value; }
+        std::vector<double>().swap(min_cost);
+
+        double solution_value = knapsack::rebuild(routes, items, 0, items.size(), scale, total_budget, value, allocation);
+
+        upper_bound = std::min(upper_bound, solution_value + items.size()*scale);
+        upper_bound = std::max(upper_bound, solution_value);
+        return solution_value;
+    }
 
-            // this is the value we get when taking none of this item type
-            auto countValue = last > 0 ? solution[cur_budget][last-1] : 0.0;
-            if (max_value <= countValue) { continue; }
+    /**
+        Holds what we need to re-optimize quickly after a single route changes: the table over the
+        routes in their order, whose row i considers the routes up to i, and the table over the routes
+        in reverse order, whose row i considers the routes from i on.
+    */
+    struct WhatIf
+    {
+        double total_budget = 0.0;
+        Table prefix;
+        Table suffix;
+    };
 
-            // now we want to figure out how many of this item type we need to reach the maximum value
+    /**
+        Fills the prefix and suffix tables for re-optimizing after single route changes.
+
+        @param routes the vector with the routes, our items
+        @param total_budget the total given budget
+        @param cost_gcd the greatest common divisor of all route costs
+        @param what_if the tables to fill
+        @param workers the threads to compute the rows on, or nullptr to stay on this thread
+    */
+    void prepare(
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const double& total_budget,
+        const double& cost_gcd,
+        WhatIf& what_if,
+        pool::Pool* workers = nullptr)
+    {
+        what_if.total_budget = total_budget;
+        knapsack::solve(routes, total_budget, cost_gcd, what_if.prefix, workers);
+
+        Table& suffix = what_if.suffix;
+        suffix.unit = cost_gcd;
+        suffix.rows = routes.size();
+        suffix.columns = what_if.prefix.columns;
+        suffix.values.assign(suffix.rows*suffix.columns, 0.0);
+        for (size_t last = suffix.rows; last-- > 0;)
+        {
             auto& route = routes[last];
-            int takeCount = 0;
-            while (max_value > countValue)
+            const double* previous = last+1 < suffix.rows ? &suffix.values[(last+1)*suffix.columns] : nullptr;
+            knapsack::layer(*route, knapsack::units(route->cost, cost_gcd), previous,
+                &suffix.values[last*suffix.columns], suffix.columns, workers);
+        }
+    }
+
+    /**
+        Finds an optimal allocation when the route at the given index is replaced by the given one, for
+        example one with a different cost, different numbers of buses or different benefits. The changed
+        route may cost anything, also amounts that are no multiple of the greatest common divisor.
+
+        Any allocation spends some money on the routes before the index, buys some number t of buses
+        of the changed route, and spends some money on the routes after the index. The costs of the
+        other routes are multiples of the divisor, so with t buses bought, the routes before and after
+        share M(t) budget units, which is the rest of the total budget rounded down. The best way to share
+        them is the maximum over s of the prefix row's value for M(t)-s units plus the suffix row's value
+        for s units. We look at all t, which takes O(k * budget units) time instead of the
+        O(routes * k * budget units) of solving again.
+
+        @param what_if the prepared tables
+        @param routes the vector with the routes, our items, without the change
+        @param index the index of the changed route, which must be less than the number of routes the
+            tables were prepared for; otherwise nothing is allocated
+        @param changed the changed route
+        @param allocation our optimal route allocation
+        @return the number of targets this allocation will, on expectation, reach
+    */
+    double reoptimize(
+        const WhatIf& what_if,
+        const std::vector<std::unique_ptr<intersection::Route>>& routes,
+        size_t index,
+        const intersection::Route& changed,
+        std::map<int, int>& allocation)
+    {
+        const Table& prefix = what_if.prefix;
+        const Table& suffix = what_if.suffix;
+        if (index >= prefix.rows or index >= routes.size())
+        {
+            std::clog << "There is no route at index " << index << " to change" << std::endl;
+            return 0.0;
+        }
+
+        const size_t columns = prefix.columns;
+        std::vector<double> zeros(columns, 0.0);
+        const double* before = index > 0 ? &prefix.values[(index-1)*columns] : zeros.data();
+        const double* after = index+1 < suffix.rows ? &suffix.values[(index+1)*columns] : zeros.data();
+
+        double max_value = -1.0;
+        int best_count = 0;
+        size_t best_split = 0;
+        size_t best_units = 0;
+        for (size_t count = 0; count <= changed.benefits.size() and count*changed.cost <= what_if.total_budget; ++count)
+        {
+            size_t shared_units = std::min(columns-1, knapsack::units(what_if.total_budget - count*changed.cost, prefix.unit));
+            double bought = count > 0 ? changed.benefits[count-1] : 0.0;
+            for (size_t split = 0; split <= shared_units; ++split)
             {
-                cur_budget -= route->cost; // this must not make cur_budget negative because max_value is reachable
-                countValue = (last > 0 && cur_budget >= min_cost) ? solution[cur_budget][last-1] : 0.0;
-                countValue += route->benefits[takeCount];
-                ++takeCount;
+                double countValue = before[shared_units - split] + after[split] + bought;
+                if (countValue > max_value)
+                {
+                    max_value = countValue;
+                    best_count = count;
+                    best_split = split;
+                    best_units = shared_units;
+                }
             }
-            allocation[route->outputId] = takeCount;
         }
 
-        return solution_value;
+        if (best_count > 0) { allocation[changed.outputId] = best_count; }
+
+        // walk back through the prefix rows with the budget left for the routes before the index
+        size_t cur_units = best_units - best_split;
+        for (size_t last = index; last-- > 0;)
+        {
+            auto& route = routes[last];
+            const double* previous = last > 0 ? &prefix.values[(last-1)*columns] : nullptr;
+            int takeCount = knapsack::take(*route, knapsack::units(route->cost, prefix.unit),
+                previous, &prefix.values[last*columns], cur_units);
+            if (takeCount > 0) { allocation[route->outputId] = takeCount; }
+        }
+
+        // walk forward through the suffix rows with the budget left for the routes after the index
+        cur_units = best_split;
+        for (size_t first = index+1; first < suffix.rows; ++first)
+        {
+            auto& route = routes[first];
+            const double* previous = first+1 < suffix.rows ? &suffix.values[(first+1)*columns] : nullptr;
+            int takeCount = knapsack::take(*route, knapsack::units(route->cost, suffix.unit),
+                previous, &suffix.values[first*columns], cur_units);
+            if (takeCount > 0) { allocation[route->outputId] = takeCount; }
+        }
+
+        return max_value;
     }
 }
@@ -1,3 +1,3 @@
 #!/bin/bash
 
-zip busproject Main.cpp parse.hpp intersection.hpp knapsack.hpp README.md
+zip busproject Main.cpp parse.hpp intersection.hpp knapsack.hpp pool.hpp store.hpp dataset.hpp compressed.hpp cache.hpp server.hpp convert_Main.cpp README.md
@@ -11,7 +11,8 @@ namespace parse
         @param max_pos the end of the string range
         @return if encountered '[' before any ']' then true, otherwise false
     */
-    bool next(std::string::const_iterator& pos, const std::string::const_iterator& max_pos)
+    template<typename Iterator>
+    bool next(Iterator& pos, const Iterator& max_pos)
     {
         for (; pos != max_pos; ++pos)
         {
@@ -36,7 +37,8 @@ namespace parse
         @param max_pos the end of the string range
         @return false if the range ended before we found the character, otherwise true
     */
-    bool skip(char skip, std::string::const_iterator& pos, const std::string::const_iterator& max_pos)
+    template<typename Iterator>
+    bool skip(char skip, Iterator& pos, const Iterator& max_pos)
     {
         for (; pos != max_pos; ++pos)
         {
@@ -60,7 +62,8 @@ namespace parse
         @param max_pos the end of the string range
         @return false if the range ended unexpectedly, otherwise true
     */
-    bool int_number(int &number, std::string::const_iterator& pos, const std::string::const_iterator& max_pos)
+    template<typename Iterator>
+    bool int_number(int &number, Iterator& pos, const Iterator& max_pos)
     {
         // 1) content check
         // 2) iterate
@@ -99,27 +102,332 @@ namespace parse
         return true;
     }
 
+    // the decimal exponents of the table of powers of five, outside of which strtod parses the numbers
+    const int SMALLEST_POWER = -64;
+    const int LARGEST_POWER = 64;
+
+    /**
+        The powers of five from 5^SMALLEST_POWER to 5^LARGEST_POWER, each as the 128 most significant bits
+        of its binary expansion, the higher 64 bits first. Negative powers are rounded up, positive ones down.
+    */
+    const uint64_t POWERS_OF_FIVE[LARGEST_POWER - SMALLEST_POWER + 1][2] {
+            {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL}, // 5^-64
+            {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL}, // 5^-63
+            {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL}, // 5^-62
+            {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL}, // 5^-61
+            {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL}, // 5^-60
+            {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL}, // 5^-59
+            {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL}, // 5^-58
+            {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL}, // 5^-57
+            {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL}, // 5^-56
+            {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL}, // 5^-55
+            {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL}, // 5^-54
+            {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL}, // 5^-53
+            {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL}, // 5^-52
+            {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL}, // 5^-51
+            {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL}, // 5^-50
+            {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL}, // 5^-49
+            {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL}, // 5^-48
+            {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL}, // 5^-47
+            {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL}, // 5^-46
+            {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL}, // 5^-45
+            {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL}, // 5^-44
+            {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL}, // 5^-43
+            {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL}, // 5^-42
+            {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL}, // 5^-41
+            {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL}, // 5^-40
+            {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL}, // 5^-39
+            {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL}, // 5^-38
+            {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL}, // 5^-37
+            {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL}, // 5^-36
+            {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL}, // 5^-35
+            {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL}, // 5^-34
+            {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL}, // 5^-33
+            {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL}, // 5^-32
+            {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL}, // 5^-31
+            {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL}, // 5^-30
+            {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL}, // 5^-29
+            {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL}, // 5^-28
+            {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL}, // 5^-27
+            {0xc612062576589ddaULL, 0x95364afe032a819eULL}, // 5^-26
+            {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL}, // 5^-25
+            {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL}, // 5^-24
+            {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL}, // 5^-23
+            {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL}, // 5^-22
+            {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL}, // 5^-21
+            {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL}, // 5^-20
+            {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL}, // 5^-19
+            {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL}, // 5^-18
+            {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL}, // 5^-17
+            {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL}, // 5^-16
+            {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL}, // 5^-15
+            {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL}, // 5^-14
+            {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL}, // 5^-13
+            {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL}, // 5^-12
+            {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL}, // 5^-11
+            {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL}, // 5^-10
+            {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL}, // 5^-9
+            {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL}, // 5^-8
+            {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL}, // 5^-7
+            {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL}, // 5^-6
+            {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL}, // 5^-5
+            {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL}, // 5^-4
+            {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL}, // 5^-3
+            {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL}, // 5^-2
+            {0xccccccccccccccccULL, 0xcccccccccccccccdULL}, // 5^-1
+            {0x8000000000000000ULL, 0x0000000000000000ULL}, // 5^0
+            {0xa000000000000000ULL, 0x0000000000000000ULL}, // 5^1
+            {0xc800000000000000ULL, 0x0000000000000000ULL}, // 5^2
+            {0xfa00000000000000ULL, 0x0000000000000000ULL}, // 5^3
+            {0x9c40000000000000ULL, 0x0000000000000000ULL}, // 5^4
+            {0xc350000000000000ULL, 0x0000000000000000ULL}, // 5^5
+            {0xf424000000000000ULL, 0x0000000000000000ULL}, // 5^6
+            {0x9896800000000000ULL, 0x0000000000000000ULL}, // 5^7
+            {0xbebc200000000000ULL, 0x0000000000000000ULL}, // 5^8
+            {0xee6b280000000000ULL, 0x0000000000000000ULL}, // 5^9
+            {0x9502f90000000000ULL, 0x0000000000000000ULL}, // 5^10
+            {0xba43b74000000000ULL, 0x0000000000000000ULL}, // 5^11
+            {0xe8d4a51000000000ULL, 0x0000000000000000ULL}, // 5^12
+            {0x9184e72a00000000ULL, 0x0000000000000000ULL}, // 5^13
+            {0xb5e620f480000000ULL, 0x0000000000000000ULL}, // 5^14
+            {0xe35fa931a0000000ULL, 0x0000000000000000ULL}, // 5^15
+            {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL}, // 5^16
+            {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL}, // 5^17
+            {0xde0b6b3a76400000ULL, 0x0000000000000000ULL}, // 5^18
+            {0x8ac7230489e80000ULL, 0x0000000000000000ULL}, // 5^19
+            {0xad78ebc5ac620000ULL, 0x0000000000000000ULL}, // 5^20
+            {0xd8d726b7177a8000ULL, 0x0000000000000000ULL}, // 5^21
+            {0x878678326eac9000ULL, 0x0000000000000000ULL}, // 5^22
+            {0xa968163f0a57b400ULL, 0x0000000000000000ULL}, // 5^23
+            {0xd3c21bcecceda100ULL, 0x0000000000000000ULL}, // 5^24
+            {0x84595161401484a0ULL, 0x0000000000000000ULL}, // 5^25
+            {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL}, // 5^26
+            {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL}, // 5^27
+            {0x813f3978f8940984ULL, 0x4000000000000000ULL}, // 5^28
+            {0xa18f07d736b90be5ULL, 0x5000000000000000ULL}, // 5^29
+            {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL}, // 5^30
+            {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL}, // 5^31
+            {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL}, // 5^32
+            {0xc5371912364ce305ULL, 0x6c28000000000000ULL}, // 5^33
+            {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL}, // 5^34
+            {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL}, // 5^35
+            {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL}, // 5^36
+            {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL}, // 5^37
+            {0x96769950b50d88f4ULL, 0x1314448000000000ULL}, // 5^38
+            {0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL}, // 5^39
+            {0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL}, // 5^40
+            {0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL}, // 5^41
+            {0xb7abc627050305adULL, 0xf14a3d9e40000000ULL}, // 5^42
+            {0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL}, // 5^43
+            {0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL}, // 5^44
+            {0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL}, // 5^45
+            {0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL}, // 5^46
+            {0x8c213d9da502de45ULL, 0x4526f422cc340000ULL}, // 5^47
+            {0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL}, // 5^48
+            {0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL}, // 5^49
+            {0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL}, // 5^50
+            {0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL}, // 5^51
+            {0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL}, // 5^52
+            {0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL}, // 5^53
+            {0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL}, // 5^54
+            {0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL}, // 5^55
+            {0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL}, // 5^56
+            {0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL}, // 5^57
+            {0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL}, // 5^58
+            {0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL}, // 5^59
+            {0x9f4f2726179a2245ULL, 0x01d762422c946590ULL}, // 5^60
+            {0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL}, // 5^61
+            {0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL}, // 5^62
+            {0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL}, // 5^63
+            {0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL}  // 5^64
+    };
+
+    // the powers of ten which are exact doubles
+    const double POWERS_OF_TEN[23] {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    /**
+        Tests whether eight characters, read as one little-endian word, are all decimal digits.
+
+        @param chunk the eight characters
+        @return true if all eight characters are digits
+    */
+    bool eight_digits(uint64_t chunk)
+    {
+        return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+            == 0x3333333333333333ULL;
+    }
+
+    /**
+        Computes the number written by eight decimal digits, read as one little-endian word,
+        by combining pairs, quadruples and octuples of digits in a few multiplications.
+
+        @param chunk the eight digits
+        @return the number they write
+    */
+    uint32_t eight_digits_value(uint64_t chunk)
+    {
+        const uint64_t mask = 0x000000FF000000FFULL;
+        const uint64_t hundreds = 100 + (1000000ULL << 32);
+        const uint64_t ten_thousands = 1 + (10000ULL << 32);
+        chunk -= 0x3030303030303030ULL;
+        chunk = chunk*10 + (chunk >> 8);
+        chunk = (((chunk & mask) * hundreds) + (((chunk >> 16) & mask) * ten_thousands)) >> 32;
+        return static_cast<uint32_t>(chunk);
+    }
+
+    /**
+        Computes the double nearest to mantissa * 10^exponent with the algorithm of Eisel and Lemire: the mantissa
+        is multiplied with the 128 most significant bits of 5^exponent, which determine the 54 leading bits of the
+        product in all but a few cases, and these cases are detected.
+
+        @param mantissa the decimal mantissa, neither zero nor more than 19 digits long
+        @param exponent the decimal exponent
+        @param number this will store the double
+        @return false if the exponent is outside the table or the double would be subnormal or infinite
+    */
+    bool eisel_lemire(uint64_t mantissa, int64_t exponent, double& number)
+    {
+        if (exponent < SMALLEST_POWER or exponent > LARGEST_POWER) { return false; }
+        int q = static_cast<int>(exponent);
+        int zeros = __builtin_clzll(mantissa);
+        mantissa <<= zeros;
+
+        const uint64_t* power = POWERS_OF_FIVE[q - SMALLEST_POWER];
+        unsigned __int128 product = static_cast<unsigned __int128>(mantissa) * power[0];
+        uint64_t high = static_cast<uint64_t>(product >> 64);
+        uint64_t low = static_cast<uint64_t>(product);
+        if ((high & 0x1FF) == 0x1FF)
+        {
+            uint64_t correction = static_cast<uint64_t>((static_cast<unsigned __int128>(mantissa) * power[1]) >> 64);
+            low += correction;
+            if (correction > low) { ++high; }
+        }
+
+        int upper = static_cast<int>(high >> 63);
+        uint64_t bits = high >> (upper + 9);
+        int binary_exponent = (((152170 + 65536) * q) >> 16) + 63 + upper - zeros + 1023;
+        if (binary_exponent <= 0) { return false; }
+
+        // exactly halfway between two doubles, which rounds to the even one
+        if (low <= 1 and q >= -4 and q <= 23 and (bits & 3) == 1 and (bits << (upper + 9)) == high)
+        {
+            bits &= ~uint64_t(1);
+        }
+        bits += bits & 1;
+        bits >>= 1;
+        if (bits >= (uint64_t(2) << 52))
+        {
+            bits = uint64_t(1) << 52;
+            ++binary_exponent;
+        }
+        bits &= ~(uint64_t(1) << 52);
+        if (binary_exponent >= 0x7FF) { return false; }
+
+        bits |= static_cast<uint64_t>(binary_exponent) << 52;
+        std::memcpy(&number, &bits, sizeof(number));
+        return true;
+    }
+
+    /**
+        Parses an unsigned decimal number with an optional fraction and exponent, like 139.85 or 1e-3,
+        from the beginning of the range [first, max_pos) into the nearest double, that is, exactly like
+        strtod does. Eight digits of the fraction are read at a time. Numbers with at most 19 significant
+        digits are converted by exact double arithmetic or the algorithm of Eisel and Lemire, and strtod
+        converts the others. If the range does not start with a digit or '.', the parsed number is 0.
+
+        @param first the beginning of the range
+        @param max_pos the end of the range
+        @param number the double to store the result
+        @return the position after the number
+    */
+    const char* decimal(const char* first, const char* max_pos, double& number)
+    {
+        const char* pos = first;
+        uint64_t mantissa = 0;
+        for (; pos != max_pos and *pos >= '0' and *pos <= '9'; ++pos) { mantissa = mantissa*10 + (*pos - '0'); }
+        int64_t digits = pos - first;
+        int64_t exponent = 0;
+        if (pos != max_pos and *pos == '.')
+        {
+            ++pos;
+            const char* fraction = pos;
+            for (uint64_t chunk; max_pos - pos >= 8; pos += 8)
+            {
+                std::memcpy(&chunk, pos, sizeof(chunk));
+                if (not eight_digits(chunk)) { break; }
+                mantissa = mantissa*100000000 + eight_digits_value(chunk);
+            }
+            for (; pos != max_pos and *pos >= '0' and *pos <= '9'; ++pos) { mantissa = mantissa*10 + (*pos - '0'); }
+            exponent = fraction - pos;
+            digits -= exponent;
+        }
+        if (digits == 0)
+        {
+            number = 0.0;
+            return pos;
+        }
+
+        if (pos != max_pos and (*pos == 'e' or *pos == 'E'))
+        {
+            const char* power = pos + 1;
+            bool negative = power != max_pos and *power == '-';
+            if (power != max_pos and (*power == '-' or *power == '+')) { ++power; }
+            if (power != max_pos and *power >= '0' and *power <= '9')
+            {
+                int64_t value = 0;
+                for (; power != max_pos and *power >= '0' and *power <= '9'; ++power)
+                {
+                    if (value < 100000) { value = value*10 + (*power - '0'); }
+                }
+                exponent += negative ? -value : value;
+                pos = power;
+            }
+        }
+
+        // leading zeros are no significant digits
+        for (const char* zero = first; digits > 19 and zero != pos and (*zero == '0' or *zero == '.'); ++zero)
+        {
+            if (*zero == '0') { --digits; }
+        }
+        if (digits <= 19)
+        {
+            if (mantissa == 0)
+            {
+                number = 0.0;
+                return pos;
+            }
+            if (exponent >= -22 and exponent <= 22 and mantissa <= (uint64_t(1) << 53))
+            {
+                number = static_cast<double>(mantissa);
+                if (exponent < 0) { number /= POWERS_OF_TEN[-exponent]; }
+                else { number *= POWERS_OF_TEN[exponent]; }
+                return pos;
+            }
+            if (eisel_lemire(mantissa, exponent, number)) { return pos; }
+        }
+
+        std::string text {first, pos};
+        number = std::strtod(text.c_str(), nullptr);
+        return pos;
+    }
+
     /**
         Parses a double from the string range [pos, max_pos). The double may follow any sequence of
         character ':' and ' '. If the first character following that sequence is not a digit or '.',
-        the parsed double is 0.
-        Adapted from https://www.geeksforgeeks.org/fast-io-for-competitive-programming
+        the parsed double is 0. The double is the nearest one to the decimal number, see 'decimal'.
 
         @param number the double to store the result
         @param pos the beginning of the string range
         @param max_pos the end of the string range
         @return false if the range ended unexpectedly, otherwise true
     */
+    template<typename Iterator>
     bool double_number(
         double &number,
-        std::string::const_iterator& pos,
-        const std::string::const_iterator& max_pos)
+        Iterator& pos,
+        const Iterator& max_pos)
     {
-        // 1) content check
-        // 2) iterate
-        // 3) bounds check
-        // 4) read
-
         if (pos == max_pos) { return false; }
         int character = *pos;
 
@@ -136,25 +444,10 @@ namespace parse
 
             ++pos;
             if (pos == max_pos) { return false; }
-            character = *pos;
         }
 
-        double after_comma = 0.0;
-        number = 0;
-        for (; (character >= '0' and character <= '9') or (character == '.' and after_comma == 0.0);
-            character = *pos)
-        {
-            if (character == '.') { after_comma = 10; }
-            else if (after_comma == 0.0) { number = number*10 + character-'0'; }
-            else
-            {
-                number = number + (character-'0')/after_comma;
-                after_comma *= 10;
-            }
-
-            ++pos;
-            if (pos == max_pos) { break; }
-        }
+        const char* first = &*pos;
+        pos += parse::decimal(first, first + (max_pos - pos), number) - first;
 
         if (negative) { number *= -1; }
         return true;
@@ -165,6 +458,8 @@ namespace parse
 
         @param polylines the vector to store the result
         @param box this will store the boundary box of all parsed points
+        @param polyline_boxes this will store the boundary box of each parsed polyline
+        @param chunk_boxes this will store the boundary boxes of each parsed polyline's chunks of segments
         @param pos the beginning of the string range
         @param max_pos the end of the string range
         @return false if the range ended unexpectedly, otherwise true
@@ -172,8 +467,10 @@ namespace parse
     bool polylines_from_array(
         std::vector<std::vector<intersection::Point>>& polylines,
         intersection::Box& box,
-        std::string::const_iterator& pos,
-        const std::string::const_iterator& max_pos)
+        std::vector<intersection::Box>& polyline_boxes,
+        std::vector<std::vector<intersection::Box>>& chunk_boxes,
+        const char*& pos,
+        const char* max_pos)
     {
         if (!skip('[', pos, max_pos)) { return false; }
 
@@ -197,6 +494,7 @@ namespace parse
                 if (point[0] > box[1][0]) { box[1][0] = point[0]; }
                 if (point[1] > box[1][1]) { box[1][1] = point[1]; }
             }
+            intersection::bound(polyline, polyline_boxes, chunk_boxes);
         }
         return true;
     }
@@ -213,8 +511,8 @@ namespace parse
     bool polygon_from_array(
         std::vector<intersection::Point>& polygon,
         intersection::Box& box,
-        std::string::const_iterator& pos,
-        const std::string::const_iterator& max_pos)
+        const char*& pos,
+        const char* max_pos)
     {
         if (!skip('[', pos, max_pos)) { return false; }
         if (!skip('[', pos, max_pos)) { return false; }
@@ -243,207 +541,836 @@ namespace parse
     }
 
     /**
-        Parses a region GeoJSON object. The parsed region will contain target numbers that have
-        already been multiplied with time slot lengths, activity probabilities and filtered through
-        age groups.
+        Skips a JSON array of numbers and arrays, such as the coordinates of a polygon, by only matching its
+        brackets, and advances the position past its closing bracket.
 
-        @param line the line containing the GeoJSON string
+        @param pos the beginning of the string range
+        @param max_pos the end of the string range
+        @return false if the range ended before the array, otherwise true
+    */
+    bool skip_array(const char*& pos, const char* max_pos)
+    {
+        if (!skip('[', pos, max_pos)) { return false; }
+
+        for (int depth = 1; pos != max_pos; ++pos)
+        {
+            if (*pos == '[') { ++depth; }
+            else if (*pos == ']' and --depth == 0)
+            {
+                ++pos;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+        Tests whether the characters in the range [first, last) are exactly the given string literal.
+
+        @param first the beginning of the range
+        @param last the end of the range
+        @param literal the string literal
+        @return true if the range holds the literal
+    */
+    template<size_t N>
+    bool token(const char* first, const char* last, const char (&literal)[N])
+    {
+        return static_cast<size_t>(last - first) == N-1 and std::equal(first, last, literal);
+    }
+
+    /**
+        Parses a region GeoJSON object into the given region, replacing its contents. The parsed region will
+        contain target numbers that have already been multiplied with time slot lengths, activity probabilities
+        and filtered through age groups. The region's vectors keep their memory, so that one region can be
+        reused for parsing many lines. The line is parsed in place, without copying any of its tokens.
+
+        @param region the region to store the result
+        @param begin the beginning of the line containing the GeoJSON string
+        @param end the end of the line
         @param active_factors the activity probabilities of targets in different time slots
         @param target_ages the string of characters describing the age groups of our targets
-        @return a smart pointer to a region
+        @param geometry whether to parse the polygon, otherwise the region has no polygon and no box
+        @param boundary the box containing all the route polylines to parse the region lazily, or nullptr.
+            If its properties come before its geometry and give it no targets, its coordinates are skipped,
+            and it has no polygon and no box. If its box misses the boundary, its edges are not computed.
+        @return true if the line contains a feature
     */
-    std::unique_ptr<intersection::Region> region(
-        const std::string& line,
-        std::array<double, intersection::TIMESLOTS> active_factors,
-        const std::string& target_ages)
+    bool region(
+        intersection::Region& region,
+        const char* begin,
+        const char* end,
+        const std::array<double, intersection::TIMESLOTS>& active_factors,
+        const std::string& target_ages,
+        bool geometry = true,
+        const intersection::Box* boundary = nullptr)
     {
-        static const std::array<double, intersection::TIMESLOTS> slot_length {2, 8, 4};
-
-        std::unique_ptr<intersection::Region> region;
-        auto max_pos = line.cend();
-        std::string::const_iterator first = line.cbegin();
+        region.meshId = -1;
+        region.targets.fill(0.0);
+        region.population.fill(0.0);
+        region.polygon.clear();
+        region.box = {intersection::supremum, intersection::infimum};
+        intersection::split(region.polygon, region.edges);
+
+        bool feature = false;
+        bool properties = false;
+        const char* max_pos = end;
+        const char* first = begin;
         skip('"', first, max_pos);
-        std::string::const_iterator second = first;
+        const char* second = first;
         while (skip('"', second, max_pos))
         {
-            std::string json_string {first, second-1};
-            if (json_string == "Feature")
+            const char* last = second-1;
+            if (token(first, last, "Feature"))
+            {
+                feature = true;
+            }
+            else if (token(first, last, "properties"))
             {
-                region = std::make_unique<intersection::Region>();
+                properties = true;
             }
-            else if (json_string == "MESH_ID")
+            else if (token(first, last, "MESH_ID"))
             {
-                if (!parse::int_number(region->meshId, second, max_pos)) { return region; }
+                if (!parse::int_number(region.meshId, second, max_pos)) { return feature; }
             }
-            else if (second-1-first == 6 and json_string[0] == 'G'
-                and json_string[2] == '_' and json_string[3] == 'T' and json_string[4] == 'Z')
+            else if (last-first == 6 and first[0] == 'G'
+                and first[2] == '_' and first[3] == 'T' and first[4] == 'Z')
             {
-                char& age = json_string[1];
-                int time = json_string[5] - '2';
+                char age = first[1];
+                int group = age - '1';
+                int time = first[5] - '2';
 
                 auto end = target_ages.end();
-                if (std::find(target_ages.begin(), end, age) != end and time >= 0)
+                bool raw = group >= 0 and group < intersection::AGES and time >= 0 and time < intersection::TIMESLOTS;
+                bool target = std::find(target_ages.begin(), end, age) != end and time >= 0 and time < intersection::TIMESLOTS;
+                if (raw or target)
                 {
                     double more_targets;
-                    if (!parse::double_number(more_targets, second, max_pos)) { return region; }
-                    region->targets[time] += more_targets * active_factors[time] * slot_length[time];
+                    if (!parse::double_number(more_targets, second, max_pos)) { return feature; }
+                    if (raw) { region.population[group*intersection::TIMESLOTS + time] = more_targets; }
+                    if (target) { region.targets[time] += more_targets * active_factors[time] * intersection::SLOT_LENGTHS[time]; }
                 }
             }
-            else if (json_string == "coordinates")
+            else if (geometry and token(first, last, "coordinates"))
             {
-                if (!parse::polygon_from_array(region->polygon, region->box, second, max_pos)) { return region; }
+                // the properties are complete once the geometry is reached, and a region without targets adds nothing
+                if (boundary and properties and region.targets == std::array<double, intersection::TIMESLOTS>{})
+                {
+                    if (!parse::skip_array(second, max_pos)) { return feature; }
+                }
+                else
+                {
+                    if (!parse::polygon_from_array(region.polygon, region.box, second, max_pos)) { return feature; }
+                    if (not boundary or intersection::may(region.box, *boundary)) { intersection::split(region.polygon, region.edges); }
+                }
             }
 
             skip('"', second, max_pos);
             first = second;
         }
-        return region;
+        return feature;
     }
 
     /**
-        Parses a route GeoJSON object.
+        Parses a region GeoJSON object into the given region, replacing its contents, like the above.
 
+        @param region the region to store the result
         @param line the line containing the GeoJSON string
-        @return a smart pointer to a region
+        @param active_factors the activity probabilities of targets in different time slots
+        @param target_ages the string of characters describing the age groups of our targets
+        @param geometry whether to parse the polygon, otherwise the region has no polygon and no box
+        @return true if the line contains a feature
     */
-    std::unique_ptr<intersection::Route> route(const std::string& line)
+    bool region(
+        intersection::Region& region,
+        const std::string& line,
+        const std::array<double, intersection::TIMESLOTS>& active_factors,
+        const std::string& target_ages,
+        bool geometry = true)
+    {
+        return parse::region(region, line.data(), line.data() + line.size(), active_factors, target_ages, geometry);
+    }
+
+    /**
+        Parses a region GeoJSON object. The parsed region will contain target numbers that have
+        already been multiplied with time slot lengths, activity probabilities and filtered through
+        age groups.
+
+        @param line the line containing the GeoJSON string
+        @param active_factors the activity probabilities of targets in different time slots
+        @param target_ages the string of characters describing the age groups of our targets
+        @return a smart pointer to a region, or nullptr if the line contains no feature
+    */
+    std::unique_ptr<intersection::Region> region(
+        const std::string& line,
+        std::array<double, intersection::TIMESLOTS> active_factors,
+        const std::string& target_ages)
     {
-        std::unique_ptr<intersection::Route> route;
-        auto max_pos = line.cend();
-        std::string::const_iterator first = line.cbegin();
+        auto region = std::make_unique<intersection::Region>();
+        if (not parse::region(*region, line, active_factors, target_ages)) { return nullptr; }
+        return region;
+    }
+
+    /**
+        Parses a route GeoJSON object into the given route, replacing its contents.
+        The line is parsed in place, without copying any of its tokens.
+
+        @param route the route to store the result
+        @param begin the beginning of the line containing the GeoJSON string
+        @param end the end of the line
+        @return true if the line contains a feature
+    */
+    bool route(intersection::Route& route, const char* begin, const char* end)
+    {
+        route = intersection::Route{};
+
+        bool feature = false;
+        const char* max_pos = end;
+        const char* first = begin;
         skip('"', first, max_pos);
-        std::string::const_iterator second = first;
+        const char* second = first;
         while (skip('"', second, max_pos))
         {
-            std::string json_string {first, second-1};
-            if (json_string == "Feature")
+            const char* last = second-1;
+            if (token(first, last, "Feature"))
             {
-                route = std::make_unique<intersection::Route>();
+                feature = true;
             }
-            else if (json_string == "RouteID")
+            else if (token(first, last, "RouteID"))
             {
-                if (!parse::int_number(route->outputId, second, max_pos)) { return route; }
+                if (!parse::int_number(route.outputId, second, max_pos)) { return feature; }
             }
-            else if (json_string == "Cost")
+            else if (token(first, last, "Cost"))
             {
-                if (!parse::double_number(route->cost, second, max_pos)) { return route; }
+                if (!parse::double_number(route.cost, second, max_pos)) { return feature; }
             }
-            else if (json_string == "TZ2_Max")
+            else if (token(first, last, "TZ2_Max"))
             {
-                if (!parse::int_number(route->buses[0], second, max_pos)) { return route; }
+                if (!parse::int_number(route.buses[0], second, max_pos)) { return feature; }
             }
-            else if (json_string == "TZ3_Max")
+            else if (token(first, last, "TZ3_Max"))
             {
-                if (!parse::int_number(route->buses[1], second, max_pos)) { return route; }
+                if (!parse::int_number(route.buses[1], second, max_pos)) { return feature; }
             }
-            else if (json_string == "TZ4_Max")
+            else if (token(first, last, "TZ4_Max"))
             {
-                if (!parse::int_number(route->buses[2], second, max_pos)) { return route; }
+                if (!parse::int_number(route.buses[2], second, max_pos)) { return feature; }
             }
-            else if (json_string == "coordinates")
+            else if (token(first, last, "coordinates"))
             {
-                if (!parse::polylines_from_array(route->polylines, route->box, second, max_pos)) { return route; }
+                if (!parse::polylines_from_array(route.polylines, route.box,
+                    route.polyline_boxes, route.chunk_boxes, second, max_pos)) { return feature; }
             }
 
             skip('"', second, max_pos);
             first = second;
         }
+        return feature;
+    }
+
+    /**
+        Parses a route GeoJSON object into the given route, replacing its contents, like the above.
+
+        @param route the route to store the result
+        @param line the line containing the GeoJSON string
+        @return true if the line contains a feature
+    */
+    bool route(intersection::Route& route, const std::string& line)
+    {
+        return parse::route(route, line.data(), line.data() + line.size());
+    }
+
+    /**
+        Parses a route GeoJSON object.
+
+        @param line the line containing the GeoJSON string
+        @return a smart pointer to a route, or nullptr if the line contains no feature
+    */
+    std::unique_ptr<intersection::Route> route(const std::string& line)
+    {
+        auto route = std::make_unique<intersection::Route>();
+        if (not parse::route(*route, line)) { return nullptr; }
         return route;
     }
 
     /**
-        Parses a GeoJSON file containing region data.
+        Represents a file mapped read-only into memory, so that its lines can be parsed in place
+        instead of being copied into strings first. The mapping is removed with the object.
+    */
+    class Mapping
+    {
+    public:
+        /**
+            Maps the whole file into memory.
+
+            @param filename path to the file
+        */
+        explicit Mapping(const std::string& filename)
+        {
+            int descriptor = ::open(filename.c_str(), O_RDONLY);
+            if (descriptor < 0) { return; }
+
+            struct stat status;
+            if (::fstat(descriptor, &status) == 0 and S_ISREG(status.st_mode))
+            {
+                opened = true;
+                size = static_cast<size_t>(status.st_size);
+                if (size > 0)
+                {
+                    void* memory = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                    if (memory == MAP_FAILED)
+                    {
+                        opened = false;
+                        size = 0;
+                    }
+                    else
+                    {
+                        ::madvise(memory, size, MADV_SEQUENTIAL);
+                        data = static_cast<const char*>(memory);
+                    }
+                }
+            }
+            ::close(descriptor);
+        }
+
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+
+        /**
+            Unmaps the file.
+        */
+        ~Mapping()
+        {
+            if (data) { ::munmap(const_cast<char*>(data), size); }
+        }
+
+        /**
+            Returns whether the file could be mapped.
+
+            @return true if the file is mapped, even if it is empty
+        */
+        bool is_open() const
+        {
+            return opened;
+        }
+
+        /**
+            Returns the beginning of the file's contents.
+
+            @return pointer to the first character
+        */
+        const char* begin() const
+        {
+            return data;
+        }
+
+        /**
+            Returns the end of the file's contents.
+
+            @return pointer behind the last character
+        */
+        const char* end() const
+        {
+            return data + size;
+        }
+
+        /**
+            Drops the whole pages of the file before the given position from the memory of this process.
+            They are read again from the file if they are used later.
+
+            @param until the position in the file before which the contents are no longer needed
+        */
+        void release(const char* until) const
+        {
+            if (not data) { return; }
+            size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            size_t length = static_cast<size_t>(until - data) / page * page;
+            if (length > 0) { ::madvise(const_cast<char*>(data), length, MADV_DONTNEED); }
+        }
+
+    private:
+        bool opened = false;
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+
+    /**
+        Finds the next line in the range [pos, max_pos), like std::getline does in a stream,
+        and advances the position past the line and its newline character.
+
+        @param pos the beginning of the range
+        @param max_pos the end of the range
+        @param first this will store the beginning of the line
+        @param last this will store the end of the line, without its newline character
+        @return false if the range is empty, otherwise true
+    */
+    bool next_line(const char*& pos, const char* max_pos, const char*& first, const char*& last)
+    {
+        if (pos == max_pos) { return false; }
+        first = pos;
+        last = static_cast<const char*>(std::memchr(pos, '\n', max_pos - pos));
+        if (not last) { last = max_pos; }
+        pos = last == max_pos ? max_pos : last + 1;
+        return true;
+    }
+
+    // the smallest part of a file worth parsing on a thread of its own
+    const size_t MIN_CHUNK = 1 << 16;
+
+    /**
+        Splits the range [begin, end) into at most the given number of chunks of about the same size,
+        each ending right after a newline character or at the end of the range.
+
+        @param begin the beginning of the range
+        @param end the end of the range
+        @param count the number of chunks
+        @return the beginnings of the chunks, followed by the end of the range
+    */
+    std::vector<const char*> chunks(const char* begin, const char* end, size_t count)
+    {
+        std::vector<const char*> bounds {begin};
+        for (size_t c = 1; c < count; ++c)
+        {
+            const char* pos = std::max(bounds.back(), begin + static_cast<size_t>(end - begin) / count * c);
+            const char* newline = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+            if (not newline or newline + 1 == end) { break; }
+            bounds.push_back(newline + 1);
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    /**
+        Parses the lines of a mapped file into the store. With several threads, the file is split into chunks of
+        whole lines, which are parsed into stores of their own on all threads. These stores are then appended to
+        the store in the order of their chunks, so the features keep the order of the file, and the store is the
+        same as if the whole file had been parsed on one thread.
+
+        @param store the store to parse the file into
+        @param file the mapped file
+        @param workers the threads to parse the file on, or nullptr to parse it on this thread
+        @param parse_range the function parsing the lines in the range [begin, end) into a store
+    */
+    void all_chunks(
+        store::Store& store,
+        const Mapping& file,
+        pool::Pool* workers,
+        const std::function<void(store::Store&, const char*, const char*)>& parse_range)
+    {
+        size_t size = file.end() - file.begin();
+        if (not workers or workers->size() <= 1 or size < 2*MIN_CHUNK)
+        {
+            parse_range(store, file.begin(), file.end());
+            return;
+        }
+
+        auto bounds = chunks(file.begin(), file.end(), std::min(4*workers->size(), size / MIN_CHUNK));
+        std::vector<store::Store> parts(bounds.size() - 1);
+        workers->run(parts.size(), [&](size_t c) { parse_range(parts[c], bounds[c], bounds[c+1]); });
+        for (const auto& part : parts) { store::append(store, part); }
+    }
+
+    /**
+        Parses the lines of a compressed file, which is decompressed on a background thread while the blocks
+        of whole lines already decompressed are parsed on this thread, see compressed::Reader.
+
+        @param filename path to the compressed file
+        @param kind the kind of features in the file, for the error messages
+        @param parse_range the function parsing the lines in the range [begin, end)
+        @return false if the file is missing or could not be decompressed completely, otherwise true
+    */
+    bool all_blocks(
+        const std::string& filename,
+        const std::string& kind,
+        const std::function<void(const char*, const char*)>& parse_range)
+    {
+        compressed::Reader reader {filename};
+        if (not reader.is_open())
+        {
+            std::clog << "Could not find the " << kind << " geojson file " << filename << std::endl;
+            return false;
+        }
+
+        std::string block;
+        while (reader.next(block)) { parse_range(block.data(), block.data() + block.size()); }
+        if (reader.missing())
+        {
+            std::clog << "The " << kind << " geojson file " << filename << " could not be decompressed, zstd program not found" << std::endl;
+            return false;
+        }
+        if (reader.damaged())
+        {
+            std::clog << "The " << kind << " geojson file " << filename << " could not be decompressed" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+        Parses a GeoJSON file containing region data into the store. All lines are parsed into the same
+        region object, whose memory is reused, and then copied into the store's flat arrays. With several
+        threads, each chunk of the file is parsed into its own store, see 'all_chunks'.
+
+        @param store the store to add all the parsed regions to
+        @param target_ages contains the target age groups
+        @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
+        @param routes_boundary the box containing all the route polylines
+        @param filename path to the GeoJSON file
+        @param index the index to file the parsed regions in, or nullptr
+        @param workers the threads to parse the file on, or nullptr to parse it on this thread
+        @param lazy whether to leave out the regions without targets, skipping their coordinates. This does not
+            change the benefits of any route, but the store then cannot give the benefits for other target ages.
+        @return false if the file is missing, is no valid binary dataset or could not be decompressed, otherwise true
+    */
+    bool read_regions(
+        store::Store& store,
+        std::string target_ages,
+        std::array<double, intersection::TIMESLOTS> active_factors,
+        const intersection::Box& routes_boundary,
+        const std::string& filename,
+        intersection::Index* index = nullptr,
+        pool::Pool* workers = nullptr,
+        bool lazy = false
+        )
+    {
+        Mapping file {filename};
+        if (not file.is_open())
+        {
+            std::clog << "Could not find the regions geojson file " << filename << std::endl;
+            return false;
+        }
+
+        size_t regions = store.region_boxes.size();
+        if (dataset::is(file.begin(), file.end()))
+        {
+            if (not dataset::regions(store, file.begin(), file.end(), target_ages, active_factors, routes_boundary))
+            {
+                std::clog << "The regions file " << filename << " is not a valid binary dataset" << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            auto parse_range = [&](store::Store& part, const char* begin, const char* end)
+            {
+                intersection::Region region;
+                const char* pos = begin;
+                const char* first;
+                const char* last;
+                while (next_line(pos, end, first, last))
+                {
+                    if (not parse::region(region, first, last, active_factors, target_ages, true, lazy ? &routes_boundary : nullptr)) { continue; }
+                    ++part.region_features;
+                    for (size_t c = 0; c < region.population.size(); ++c) { part.population[c].push_back(region.population[c]); }
+                    if (not intersection::may(region.box, routes_boundary)) { continue; }
+
+                    part.ordinals.push_back(part.region_features - 1);
+                    store::add(part, region);
+                }
+            };
+            if (compressed::is(filename))
+            {
+                if (not all_blocks(filename, "regions", [&](const char* begin, const char* end) { parse_range(store, begin, end); })) { return false; }
+            }
+            else { all_chunks(store, file, workers, parse_range); }
+        }
+
+        if (index)
+        {
+            for (size_t r = regions; r < store.region_boxes.size(); ++r) { intersection::insert(index->grid, store.region_boxes[r], r); }
+        }
+
+        // regions which do not form a grid are indexed in an R-tree over their boxes
+        if (index and not index->grid.uniform)
+        {
+            intersection::build(index->tree, store.region_boxes);
+        }
+        return true;
+    }
+
+    /**
+        Parses a GeoJSON file containing region data into the store like 'read_regions', but ends the program
+        if the file cannot be read.
 
-        @param regions the vector to store the smart pointers to all the parsed regions
+        @param store the store to add all the parsed regions to
         @param target_ages contains the target age groups
         @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
         @param routes_boundary the box containing all the route polylines
         @param filename path to the GeoJSON file
+        @param index the index to file the parsed regions in, or nullptr
+        @param workers the threads to parse the file on, or nullptr to parse it on this thread
+        @param lazy whether to leave out the regions without targets, see 'read_regions'
     */
     void all_regions(
-        std::vector<std::unique_ptr<intersection::Region>>& regions,
+        store::Store& store,
         std::string target_ages,
         std::array<double, intersection::TIMESLOTS> active_factors,
         const intersection::Box& routes_boundary,
-        const std::string& filename
+        const std::string& filename,
+        intersection::Index* index = nullptr,
+        pool::Pool* workers = nullptr,
+        bool lazy = false
         )
     {
-        std::ifstream stream {filename};
-        if (not stream.is_open())
+        if (not parse::read_regions(store, target_ages, active_factors, routes_boundary, filename, index, workers, lazy)) { exit(-1); }
+    }
+
+    // the size of the parts of a streamed file whose pages are dropped from memory once they are parsed
+    const size_t RELEASED_CHUNK = 1 << 20;
+
+    /**
+        Streams a GeoJSON file containing region data through the routes in the store: every region is
+        parsed into the same region object, intersected with the routes near it and forgotten, and the pages
+        of the mapped file already parsed are dropped, so the memory does not grow with the number of regions.
+        The routes must be in the store, and the regions add to their benefits in the order of the file, so the
+        benefits are exactly those of 'store::all'. Without the incidence, the regions are parsed lazily, see
+        'region'. A compressed file is decompressed on a background thread, see 'all_blocks'. A binary dataset
+        has no lines to stream, so it is read into the store and intersected as a whole.
+
+        @param store the store with all routes, whose benefits this computes
+        @param target_ages contains the target age groups
+        @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
+        @param routes_boundary the box containing all the route polylines
+        @param filename path to the GeoJSON file
+        @param incidence this will store the regions each route intersects, or nullptr
+    */
+    void stream_regions(
+        store::Store& store,
+        std::string target_ages,
+        std::array<double, intersection::TIMESLOTS> active_factors,
+        const intersection::Box& routes_boundary,
+        const std::string& filename,
+        store::Incidence* incidence = nullptr
+        )
+    {
+        Mapping file {filename};
+        if (not file.is_open())
         {
             std::clog << "Could not find the regions geojson file " << filename << std::endl;
             exit(-1);
         }
+        if (dataset::is(file.begin(), file.end()))
+        {
+            intersection::Index index;
+            all_regions(store, target_ages, active_factors, routes_boundary, filename, &index);
+            store::all(store, &index, nullptr, nullptr, incidence);
+            return;
+        }
 
-        std::string line;
-        while (std::getline(stream, line))
+        std::fill(store.benefits.begin(), store.benefits.end(), 0.0);
+        for (auto& targets : store.route_targets) { targets.fill(0.0); }
+
+        intersection::RTree routes;
+        intersection::build(routes, store.route_boxes);
+        std::vector<std::vector<uint32_t>> rows(incidence ? store.output_ids.size() : 0);
+        std::vector<int> found;
+
+        intersection::Region region;
+        auto parse_range = [&](const char* begin, const char* end)
         {
-            std::unique_ptr<intersection::Region> region = parse::region(line, active_factors, target_ages);
+            const char* pos = begin;
+            const char* first;
+            const char* last;
+            while (next_line(pos, end, first, last))
+            {
+                if (not parse::region(region, first, last, active_factors, target_ages, true, incidence ? nullptr : &routes_boundary)) { continue; }
+                ++store.region_features;
+                if (not intersection::may(region.box, routes_boundary)) { continue; }
+
+                store::visit(store, routes, region, store.region_features - 1, found, incidence ? &rows : nullptr);
+            }
+        };
 
-            if (not region or not intersection::may(region->box, routes_boundary))
+        if (compressed::is(filename))
+        {
+            if (not all_blocks(filename, "regions", parse_range)) { exit(-1); }
+        }
+        else
+        {
+            // the mapped file is parsed in parts of whole lines, whose pages are dropped after them
+            for (const char* begin = file.begin(); begin != file.end();)
             {
-                continue;
+                const char* end = begin + std::min(RELEASED_CHUNK, static_cast<size_t>(file.end() - begin));
+                const char* newline = static_cast<const char*>(std::memchr(end, '\n', file.end() - end));
+                end = newline ? newline + 1 : file.end();
+                parse_range(begin, end);
+                file.release(end);
+                begin = end;
             }
+        }
 
-            regions.push_back(std::move(region));
+        if (incidence)
+        {
+            *incidence = store::Incidence{};
+            for (const auto& row : rows)
+            {
+                incidence->columns.insert(incidence->columns.end(), row.begin(), row.end());
+                incidence->starts.push_back(incidence->columns.size());
+            }
         }
     }
 
     /**
-        Parses a GeoJSON file containing route data.
+        Parses only the targets of all region features in a GeoJSON file, skipping their coordinates.
 
-        @param routes the vector to store the smart pointers to all the parsed routes
+        @param target_ages contains the target age groups
+        @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
+        @param filename path to the GeoJSON file
+        @return the targets of the n-th region feature in the file at index n
+    */
+    std::vector<std::array<double, intersection::TIMESLOTS>> all_targets(
+        const std::string& target_ages,
+        const std::array<double, intersection::TIMESLOTS>& active_factors,
+        const std::string& filename)
+    {
+        Mapping file {filename};
+        if (not file.is_open())
+        {
+            std::clog << "Could not find the regions geojson file " << filename << std::endl;
+            exit(-1);
+        }
+
+        // a binary dataset has the raw population of all features, and no box meets an empty boundary
+        if (dataset::is(file.begin(), file.end()))
+        {
+            store::Store store;
+            if (not dataset::regions(store, file.begin(), file.end(), target_ages, active_factors,
+                intersection::Box{intersection::supremum, intersection::infimum}))
+            {
+                std::clog << "The regions file " << filename << " is not a valid binary dataset" << std::endl;
+                exit(-1);
+            }
+            return store::targets(store, target_ages, active_factors);
+        }
+
+        std::vector<std::array<double, intersection::TIMESLOTS>> targets;
+        intersection::Region region;
+        auto parse_range = [&](const char* begin, const char* end)
+        {
+            const char* pos = begin;
+            const char* first;
+            const char* last;
+            while (next_line(pos, end, first, last))
+            {
+                if (not parse::region(region, first, last, active_factors, target_ages, false)) { continue; }
+                targets.push_back(region.targets);
+            }
+        };
+        if (compressed::is(filename))
+        {
+            if (not all_blocks(filename, "regions", parse_range)) { exit(-1); }
+        }
+        else { parse_range(file.begin(), file.end()); }
+        return targets;
+    }
+
+    /**
+        Parses a GeoJSON file containing route data into the store. With several threads, each chunk
+        of the file is parsed into its own store, see 'all_chunks'.
+
+        @param store the store to add all the parsed routes to
         @param min_cost this is the minimum cost of any wrapping bus (needed for optimization)
         @param cost_gcd this is the greatest divisor of the costs of all wrapping buses (needed for optimization)
         @param routes_boundary the box containing all the route polylines
         @param filename path to the GeoJSON file
+        @param workers the threads to parse the file on, or nullptr to parse it on this thread
+        @return false if the file is missing, is no valid binary dataset or could not be decompressed, otherwise true
     */
-    void all_routes(
-        std::vector<std::unique_ptr<intersection::Route>>& routes,
+    bool read_routes(
+        store::Store& store,
         double& min_cost,
         double& cost_gcd,
         intersection::Box& routes_boundary,
-        const std::string& filename)
+        const std::string& filename,
+        pool::Pool* workers = nullptr)
     {
-        std::ifstream stream {filename};
-        if (not stream.is_open())
+        Mapping file {filename};
+        if (not file.is_open())
         {
             std::clog << "Could not find the routes geojson file " << filename << std::endl;
-            exit(-1);
+            return false;
         }
 
-        std::string line;
-        while (std::getline(stream, line))
+        size_t routes = store.output_ids.size();
+        if (dataset::is(file.begin(), file.end()))
+        {
+            if (not dataset::routes(store, file.begin(), file.end()))
+            {
+                std::clog << "The routes file " << filename << " is not a valid binary dataset" << std::endl;
+                return false;
+            }
+        }
+        else
         {
-            std::unique_ptr<intersection::Route> new_route = parse::route(line);
-            if (!new_route) { continue; }
-            routes.push_back(std::move(new_route));
+            auto parse_range = [](store::Store& part, const char* begin, const char* end)
+            {
+                intersection::Route route;
+                const char* pos = begin;
+                const char* first;
+                const char* last;
+                while (next_line(pos, end, first, last))
+                {
+                    if (parse::route(route, first, last)) { store::add(part, route); }
+                }
+            };
+            if (compressed::is(filename))
+            {
+                if (not all_blocks(filename, "routes", [&](const char* begin, const char* end) { parse_range(store, begin, end); })) { return false; }
+            }
+            else { all_chunks(store, file, workers, parse_range); }
+        }
 
-            auto& route = routes.back();
-            cost_gcd = static_cast<double>(knapsack::compute_gcd(static_cast<int>(cost_gcd), static_cast<int>(route->cost)));
+        for (size_t r = routes; r < store.output_ids.size(); ++r)
+        {
+            double cost = store.costs[r];
+            const intersection::Box& box = store.route_boxes[r];
+            cost_gcd = static_cast<double>(knapsack::compute_gcd(static_cast<int>(cost_gcd), static_cast<int>(cost)));
 
-            if (route->cost < min_cost) { min_cost = route->cost; }
+            if (cost < min_cost) { min_cost = cost; }
 
-            if (route->box[0][0] < routes_boundary[0][0]) { routes_boundary[0][0] = route->box[0][0]; }
-            if (route->box[0][1] < routes_boundary[0][1]) { routes_boundary[0][1] = route->box[0][1]; }
-            if (route->box[1][0] > routes_boundary[1][0]) { routes_boundary[1][0] = route->box[1][0]; }
-            if (route->box[1][1] > routes_boundary[1][1]) { routes_boundary[1][1] = route->box[1][1]; }
+            if (box[0][0] < routes_boundary[0][0]) { routes_boundary[0][0] = box[0][0]; }
+            if (box[0][1] < routes_boundary[0][1]) { routes_boundary[0][1] = box[0][1]; }
+            if (box[1][0] > routes_boundary[1][0]) { routes_boundary[1][0] = box[1][0]; }
+            if (box[1][1] > routes_boundary[1][1]) { routes_boundary[1][1] = box[1][1]; }
         }
+        return true;
+    }
+
+    /**
+        Parses a GeoJSON file containing route data into the store like 'read_routes', but ends the program
+        if the file cannot be read.
+
+        @param store the store to add all the parsed routes to
+        @param min_cost this is the minimum cost of any wrapping bus (needed for optimization)
+        @param cost_gcd this is the greatest divisor of the costs of all wrapping buses (needed for optimization)
+        @param routes_boundary the box containing all the route polylines
+        @param filename path to the GeoJSON file
+        @param workers the threads to parse the file on, or nullptr to parse it on this thread
+    */
+    void all_routes(
+        store::Store& store,
+        double& min_cost,
+        double& cost_gcd,
+        intersection::Box& routes_boundary,
+        const std::string& filename,
+        pool::Pool* workers = nullptr)
+    {
+        if (not parse::read_routes(store, min_cost, cost_gcd, routes_boundary, filename, workers)) { exit(-1); }
     }
 
     /**
-        Parses activity factors, that is, the expected ratios of people outside of buildings at different times.
+        Parses activity factors, that is, the expected ratios of people outside of buildings at different times,
+        without ending the program if the file is invalid.
 
         @param filename path to the file with the activity factors in specific CSV format
-        @return the activity factors
+        @param actives this will store the activity factors
+        @return the message describing what is wrong with the file, or an empty string if it is valid
     */
-    std::array<double, intersection::TIMESLOTS> active_factors(const std::string& filename)
+    std::string read_active_factors(const std::string& filename, std::array<double, intersection::TIMESLOTS>& actives)
     {
         std::ifstream stream (filename);
         if (not stream.is_open())
         {
-            std::clog << "Route geojson file missing!" << std::endl;
-            exit(-1);
+            return "Could not find the activity file " + filename;
         }
 
         std::string factor_string;
@@ -453,16 +1380,41 @@ namespace parse
         std::getline(stream, factor_string, ',');
 
         // read the columns 2,3,4 of second line
-        std::array<double, intersection::TIMESLOTS> actives;
-        for (int f = 0; std::getline(stream, factor_string, ','); ++f)
+        int f = 0;
+        for (; std::getline(stream, factor_string, ','); ++f)
         {
+            if (f == intersection::TIMESLOTS)
+            {
+                return "The activity file " + filename + " has more than " + std::to_string(intersection::TIMESLOTS) + " activity factors";
+            }
             try { actives[f] = std::stod(factor_string); }
             catch (const std::logic_error& ex)
             {
-                std::clog << "Active factor " << factor_string << " could not be parsed: " << ex.what() << std::endl;
-                exit(-1);
+                return "Active factor " + factor_string + " could not be parsed: " + ex.what();
             }
         }
+        if (f < intersection::TIMESLOTS)
+        {
+            return "The activity file " + filename + " has fewer than " + std::to_string(intersection::TIMESLOTS) + " activity factors";
+        }
+        return "";
+    }
+
+    /**
+        Parses activity factors like 'read_active_factors', but ends the program if the file is invalid.
+
+        @param filename path to the file with the activity factors in specific CSV format
+        @return the activity factors
+    */
+    std::array<double, intersection::TIMESLOTS> active_factors(const std::string& filename)
+    {
+        std::array<double, intersection::TIMESLOTS> actives;
+        std::string message = parse::read_active_factors(filename, actives);
+        if (not message.empty())
+        {
+            std::clog << message << std::endl;
+            exit(-1);
+        }
         return actives;
     }
 
@@ -524,8 +1476,51 @@ namespace parse
     }
 
     /**
-        Parses the entire input, that is, the target age groups, the budget, the activity probabilities,
-        the regions and the routes.
+        Parses the entire input into the store, that is, the target age groups, the budget, the activity
+        probabilities, the regions and the routes.
+
+        @param store the store to add the regions and routes to
+        @param budget total given budget
+        @param min_cost this is the minimum cost of any wrapping bus (needed for optimization)
+        @param cost_gcd this is the greatest divisor of the costs of all wrapping buses (needed for optimization)
+        @param age_string The comma-separated string of age groups read from the stdin
+        @param budget_string The budget string read from stdin
+        @param regions_path The path to the GeoJSON file with region data
+        @param routes_path The path to the GeoJSON file with route data
+        @param active_path The path to the CSV file with activity probabilities
+        @param index the index to file the parsed regions in, or nullptr
+        @param workers the threads to parse the files on, or nullptr
+        @param lazy whether to leave out the regions without targets, see 'all_regions'
+    */
+    void input(
+        store::Store& store,
+        double& budget,
+        double& min_cost,
+        double& cost_gcd,
+        const std::string& age_string,
+        const std::string& budget_string,
+        const std::string& regions_path,
+        const std::string& routes_path,
+        const std::string& active_path,
+        intersection::Index* index = nullptr,
+        pool::Pool* workers = nullptr,
+        bool lazy = false)
+    {
+        std::string target_ages = parse::target_ages(age_string);
+
+        budget = parse::budget(budget_string);
+
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        parse::all_routes(store, min_cost, cost_gcd, routes_boundary, routes_path, workers);
+
+        std::array<double, intersection::TIMESLOTS> active_factors = parse::active_factors(active_path);
+
+        parse::all_regions(store, target_ages, active_factors, routes_boundary, regions_path, index, workers, lazy);
+    }
+
+    /**
+        Parses the entire input into the store, like the above, and hands out its regions and routes
+        as separate objects with their geometry, see store::objects.
 
         @param regions vector to store the regions
         @param routes vector to store the routes
@@ -537,6 +1532,7 @@ namespace parse
         @param regions_path The path to the GeoJSON file with region data
         @param routes_path The path to the GeoJSON file with route data
         @param active_path The path to the CSV file with activity probabilities
+        @param index the index to file the parsed regions in, or nullptr
     */
     void input(
         std::vector<std::unique_ptr<intersection::Region>>& regions,
@@ -548,17 +1544,167 @@ namespace parse
         const std::string& budget_string,
         const std::string& regions_path,
         const std::string& routes_path,
-        const std::string& active_path)
+        const std::string& active_path,
+        intersection::Index* index = nullptr)
+    {
+        store::Store store;
+        parse::input(store, budget, min_cost, cost_gcd,
+            age_string, budget_string, regions_path, routes_path, active_path, index);
+        store::objects(store, regions, routes);
+    }
+
+    /**
+        Parses the routes into the store and streams the regions through them, see 'stream_regions'.
+        Afterwards the store has all routes with their benefits, but no regions.
+
+        @param store the store to add the routes to
+        @param budget total given budget
+        @param min_cost this is the minimum cost of any wrapping bus (needed for optimization)
+        @param cost_gcd this is the greatest divisor of the costs of all wrapping buses (needed for optimization)
+        @param age_string The comma-separated string of age groups read from the stdin
+        @param budget_string The budget string read from stdin
+        @param regions_path The path to the GeoJSON file with region data
+        @param routes_path The path to the GeoJSON file with route data
+        @param active_path The path to the CSV file with activity probabilities
+        @param workers the threads to parse the routes on, or nullptr
+    */
+    void stream(
+        store::Store& store,
+        double& budget,
+        double& min_cost,
+        double& cost_gcd,
+        const std::string& age_string,
+        const std::string& budget_string,
+        const std::string& regions_path,
+        const std::string& routes_path,
+        const std::string& active_path,
+        pool::Pool* workers = nullptr)
     {
         std::string target_ages = parse::target_ages(age_string);
 
         budget = parse::budget(budget_string);
 
         intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
-        parse::all_routes(routes, min_cost, cost_gcd, routes_boundary, routes_path);
+        parse::all_routes(store, min_cost, cost_gcd, routes_boundary, routes_path, workers);
 
         std::array<double, intersection::TIMESLOTS> active_factors = parse::active_factors(active_path);
 
-        parse::all_regions(regions, target_ages, active_factors, routes_boundary, regions_path);
+        parse::stream_regions(store, target_ages, active_factors, routes_boundary, regions_path);
+    }
+
+    /**
+        Represents the options given on the command line. Without any options, the program
+        solves the problem with the full dynamic programming table.
+    */
+    struct Options
+    {
+        bool linear = false;
+        bool frontier = false;
+        size_t threads = 1;
+        double epsilon = 0.0;
+        bool stream = false;
+        bool serve = false;
+        std::vector<double> budgets;
+        std::string cache;
+        std::string batch;
+    };
+
+    /**
+        Parses the command line options.
+
+        @param argc the number of command line arguments
+        @param argv the command line arguments, the first being the program name
+        @return the parsed options
+    */
+    Options options(int argc, char* argv[])
+    {
+        Options options;
+        for (int a = 1; a < argc; ++a)
+        {
+            std::string argument {argv[a]};
+            if (argument == "--linear")
+            {
+                options.linear = true;
+            }
+            else if (argument.compare(0, 10, "--threads=") == 0)
+            {
+                int threads = 0;
+                auto pos = argument.cbegin() + 10;
+                if (!parse::int_number(threads, pos, argument.cend()) or threads < 1 or pos != argument.cend())
+                {
+                    std::clog << "Thread count " << argument.substr(10) << " is not a positive integer" << std::endl;
+                    exit(-1);
+                }
+                options.threads = threads;
+            }
+            else if (argument.compare(0, 10, "--epsilon=") == 0)
+            {
+                double epsilon = 0.0;
+                auto pos = argument.cbegin() + 10;
+                if (!parse::double_number(epsilon, pos, argument.cend()) or pos != argument.cend() or epsilon <= 0.0 or epsilon >= 1.0)
+                {
+                    std::clog << "Epsilon " << argument.substr(10) << " is not a number strictly between 0 and 1" << std::endl;
+                    exit(-1);
+                }
+                options.epsilon = epsilon;
+            }
+            else if (argument == "--frontier")
+            {
+                options.frontier = true;
+            }
+            else if (argument == "--stream")
+            {
+                options.stream = true;
+            }
+            else if (argument == "--serve")
+            {
+                options.serve = true;
+            }
+            else if (argument.compare(0, 8, "--cache=") == 0 and argument.size() > 8)
+            {
+                options.cache = argument.substr(8);
+            }
+            else if (argument.compare(0, 8, "--batch=") == 0 and argument.size() > 8)
+            {
+                options.batch = argument.substr(8);
+            }
+            else if (argument.compare(0, 10, "--budgets=") == 0)
+            {
+                std::stringstream stream(argument.substr(10));
+                std::string budget_string;
+                while (std::getline(stream, budget_string, ','))
+                {
+                    options.budgets.push_back(parse::budget(budget_string));
+                }
+            }
+            else
+            {
+                std::clog << "Unknown option " << argument << std::endl;
+                exit(-1);
+            }
+        }
+        if (options.linear and (options.frontier or not options.budgets.empty()))
+        {
+            std::clog << "The option --linear cannot be combined with --frontier or --budgets" << std::endl;
+            exit(-1);
+        }
+        if (options.epsilon > 0.0 and (options.linear or options.frontier or not options.budgets.empty()))
+        {
+            std::clog << "The option --epsilon cannot be combined with --linear, --frontier or --budgets" << std::endl;
+            exit(-1);
+        }
+        if (options.stream and not options.cache.empty())
+        {
+            std::clog << "The option --stream cannot be combined with --cache" << std::endl;
+            exit(-1);
+        }
+        bool served = options.serve or not options.batch.empty();
+        if (served and (options.linear or options.frontier or not options.budgets.empty() or options.epsilon > 0.0
+            or options.stream or not options.cache.empty() or (options.serve and not options.batch.empty())))
+        {
+            std::clog << "The options --serve and --batch can only be combined with --threads" << std::endl;
+            exit(-1);
+        }
+        return options;
     }
 }
@@ -0,0 +1,202 @@
+#pragma once
+
+namespace pool
+{
+    /**
+        Represents a fixed set of worker threads which are started once and then reused for many
+        parallel loops, so that we do not pay for starting threads in every loop.
+
+        The thread calling 'run' takes part in the work, so a pool of size one has no worker
+        threads at all and runs everything on the calling thread.
+    */
+    class Pool
+    {
+    public:
+        /**
+            Starts the worker threads.
+
+            @param size the number of threads working on a loop, including the calling thread
+        */
+        explicit Pool(size_t size)
+            : ranges(std::max<size_t>(size, 1))
+        {
+            for (size_t w = 1; w < size; ++w)
+            {
+                workers.emplace_back([this, w] { work(w); });
+            }
+        }
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        /**
+            Stops and joins the worker threads.
+        */
+        ~Pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock {mutex};
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers) { worker.join(); }
+        }
+
+        /**
+            Returns the number of threads working on a loop, including the calling thread.
+
+            @return number of threads
+        */
+        size_t size() const
+        {
+            return workers.size() + 1;
+        }
+
+        /**
+            Calls task(0), ..., task(count-1) on all threads of this pool and returns once
+            all of these calls have returned. The calls must not depend on each other.
+
+            The indices are scheduled by work stealing: every thread starts with its own contiguous
+            range of indices and takes them from the front. A thread whose range is empty steals
+            the back half of another thread's range, so uneven tasks still keep all threads busy,
+            while every thread mostly works on neighbouring indices.
+
+            @param count the number of tasks
+            @param task the function receiving the task index
+        */
+        void run(size_t count, const std::function<void(size_t)>& task)
+        {
+            if (workers.empty() or count <= 1)
+            {
+                for (size_t t = 0; t < count; ++t) { task(t); }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock {mutex};
+                current = &task;
+                for (size_t r = 0; r < ranges.size(); ++r)
+                {
+                    std::lock_guard<std::mutex> range_lock {ranges[r].mutex};
+                    ranges[r].begin = count*r/ranges.size();
+                    ranges[r].end = count*(r+1)/ranges.size();
+                }
+                busy = workers.size();
+                ++generation;
+            }
+            wake.notify_all();
+
+            take(task, 0);
+
+            std::unique_lock<std::mutex> lock {mutex};
+            done.wait(lock, [this] { return busy == 0; });
+            current = nullptr;
+        }
+
+    private:
+        /**
+            Represents the indices not yet taken by one thread, from begin up to end.
+        */
+        struct Range
+        {
+            std::mutex mutex;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        /**
+            Takes task indices from the own range, and steals from the other threads' ranges
+            once it is empty, until there are no indices left anywhere.
+
+            @param task the function receiving the task index
+            @param thread the number of the calling thread, which is 0 for the thread calling 'run'
+        */
+        void take(const std::function<void(size_t)>& task, size_t thread)
+        {
+            Range& own = ranges[thread];
+            while (true)
+            {
+                size_t t = 0;
+                bool found;
+                {
+                    std::lock_guard<std::mutex> lock {own.mutex};
+                    found = own.begin < own.end;
+                    if (found) { t = own.begin++; }
+                }
+                if (found)
+                {
+                    task(t);
+                    continue;
+                }
+                if (not steal(thread)) { return; }
+            }
+        }
+
+        /**
+            Moves the back half of another thread's range into the own empty range.
+
+            @param thread the number of the calling thread
+            @return false if all ranges were empty
+        */
+        bool steal(size_t thread)
+        {
+            for (size_t offset = 1; offset < ranges.size(); ++offset)
+            {
+                Range& victim = ranges[(thread + offset) % ranges.size()];
+                size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> lock {victim.mutex};
+                    if (victim.begin >= victim.end) { continue; }
+                    begin = victim.begin + (victim.end - victim.begin)/2;
+                    end = victim.end;
+                    victim.end = begin;
+                }
+                Range& own = ranges[thread];
+                std::lock_guard<std::mutex> lock {own.mutex};
+                own.begin = begin;
+                own.end = end;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+            The loop of a worker thread: wait for a new loop, take part in it, and report back.
+
+            @param thread the number of this worker thread, starting from 1
+        */
+        void work(size_t thread)
+        {
+            size_t seen = 0;
+            while (true)
+            {
+                const std::function<void(size_t)>* task;
+                {
+                    std::unique_lock<std::mutex> lock {mutex};
+                    wake.wait(lock, [this, seen] { return stopping or generation != seen; });
+                    if (stopping) { return; }
+                    seen = generation;
+                    task = current;
+                }
+
+                take(*task, thread);
+
+                {
+                    std::lock_guard<std::mutex> lock {mutex};
+                    --busy;
+                }
+                done.notify_one();
+            }
+        }
+
+        std::vector<Range> ranges;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(size_t)>* current = nullptr;
+        size_t busy = 0;
+        size_t generation = 0;
+        bool stopping = false;
+    };
+}
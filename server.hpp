@@ -0,0 +1,403 @@
+#pragma once
+
+namespace server
+{
+    /**
+        Represents the data a server keeps resident between queries: the routes without their geometry,
+        the raw population of all region features and the regions each route intersects. These give the
+        benefits for any target ages and activity probabilities without parsing or intersecting again.
+        The data is never changed once loaded, so queries can share it while newer data is being loaded.
+    */
+    struct Data
+    {
+        store::Store store;
+        store::Incidence incidence;
+        double min_cost = std::numeric_limits<double>::infinity();
+        double cost_gcd = 0.0;
+        cache::Key key;
+    };
+
+    /**
+        Checks whether a GeoJSON file has been written completely, that is, whether its text ends with the brace
+        closing the feature collection. Binary datasets and compressed files are checked while they are read.
+
+        @param filename path to the file
+        @return true if the file exists and is complete
+    */
+    bool complete(const std::string& filename)
+    {
+        parse::Mapping file {filename};
+        if (not file.is_open()) { return false; }
+        if (compressed::is(filename) or dataset::is(file.begin(), file.end())) { return true; }
+
+        const char* end = file.end();
+        while (end != file.begin() and isspace(end[-1])) { --end; }
+        return end != file.begin() and end[-1] == '}';
+    }
+
+    /**
+        Loads the data from the GeoJSON files or binary datasets: parses the routes and all regions,
+        intersects them and keeps everything but the geometry. Unlike the rest of the program, this does not
+        end the program if a file is missing, incomplete, damaged or without features, so that a server can
+        keep answering from its old data.
+
+        @param key the hashes of the contents of the files
+        @param regions_path path to the file with the regions
+        @param routes_path path to the file with the routes
+        @param workers the threads to parse and intersect on, or nullptr to stay on this thread
+        @return the data, or nullptr if the files cannot be loaded
+    */
+    std::shared_ptr<const Data> load(
+        const cache::Key& key,
+        const std::string& regions_path,
+        const std::string& routes_path,
+        pool::Pool* workers = nullptr)
+    {
+        auto data = std::make_shared<Data>();
+        data->key = key;
+
+        for (const auto& path : {regions_path, routes_path})
+        {
+            if (not complete(path))
+            {
+                std::clog << "The file " << path << " is missing or incomplete" << std::endl;
+                return nullptr;
+            }
+        }
+
+        store::Store store;
+        intersection::Index index;
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        if (not parse::read_routes(store, data->min_cost, data->cost_gcd, routes_boundary, routes_path, workers)
+            or not parse::read_regions(store, "", {0., 0., 0.}, routes_boundary, regions_path, &index, workers))
+        {
+            return nullptr;
+        }
+        if (store.output_ids.empty() or store.region_features == 0)
+        {
+            std::clog << "The files " << regions_path << " and " << routes_path << " have no "
+                << (store.output_ids.empty() ? "routes" : "regions") << std::endl;
+            return nullptr;
+        }
+        store::all(store, &index, nullptr, workers, &data->incidence);
+
+        data->store = store::routes(store);
+        data->store.region_features = store.region_features;
+        data->store.population = std::move(store.population);
+        return data;
+    }
+
+    /**
+        Finds an optimal allocation for some target ages, activity probabilities and budget from the resident
+        data. The benefits are computed from the population and the incidence, so they are exactly those
+        of a run of the program on the same files.
+
+        @param data the resident data
+        @param target_ages contains the target age groups
+        @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
+        @param budget total given budget
+        @param allocation our optimal route allocation
+        @param workers the threads to compute the rows of the table on, or nullptr to stay on this thread
+        @return the number of targets the allocation will, on expectation, reach
+    */
+    double answer(
+        const Data& data,
+        const std::string& target_ages,
+        const std::array<double, intersection::TIMESLOTS>& active_factors,
+        double budget,
+        std::map<int, int>& allocation,
+        pool::Pool* workers = nullptr)
+    {
+        store::Store routes = store::routes(data.store);
+        store::benefits(routes, data.incidence, store::targets(data.store, target_ages, active_factors));
+        std::vector<std::unique_ptr<intersection::Route>> items;
+        store::items(routes, items);
+        return knapsack::optimize(items, budget, data.min_cost, data.cost_gcd, allocation, workers);
+    }
+
+    /**
+        Checks whether a string is a comma-separated list of age groups '1' through '6', each of which
+        may be surrounded by spaces, so that parse::target_ages accepts it.
+
+        @param age_string the string
+        @return true if the age groups are valid
+    */
+    bool valid_ages(const std::string& age_string)
+    {
+        std::stringstream stream(age_string);
+        std::string group;
+        while (std::getline(stream, group, ','))
+        {
+            group.erase(std::remove_if(group.begin(), group.end(), ::isspace), group.end());
+            if (group.size() != 1 or group[0] < '1' or group[0] > '6') { return false; }
+        }
+        return true;
+    }
+
+    /**
+        Checks whether a query can be answered, so that an invalid query does not end the program.
+
+        @param age_string the comma-separated string of age groups of the query
+        @param budget_string the budget string of the query
+        @param active_path the path to the CSV file with activity probabilities of the query
+        @param budget this will store the budget of a valid query
+        @param active_factors this will store the activity probabilities of a valid query
+        @return the message describing what is wrong with the query, or an empty string if it is valid
+    */
+    std::string error(
+        const std::string& age_string,
+        const std::string& budget_string,
+        const std::string& active_path,
+        double& budget,
+        std::array<double, intersection::TIMESLOTS>& active_factors)
+    {
+        auto pos = budget_string.cbegin();
+        if (not valid_ages(age_string))
+        {
+            return "Age groups " + age_string + " are not valid";
+        }
+        if (!parse::double_number(budget, pos, budget_string.cend()) or pos != budget_string.cend())
+        {
+            return "Budget " + budget_string + " is not a number";
+        }
+        return parse::read_active_factors(active_path, active_factors);
+    }
+
+    /**
+        Serves queries from the input stream until it ends, keeping the data of the given files resident.
+        A query consists of three lines, TARGET_AGES, BUDGET and ACTIVE_CSV, like the lines 1, 2 and 5
+        of the input of the program. It is answered with the lines ROUTE_ID,COUNT of its allocation,
+        or a line ERROR,MESSAGE if it is invalid, followed by a line END.
+
+        A line RELOAD loads the files again on a background thread if their contents have changed, while
+        the following queries are still answered from the old data. The new data then replaces the old
+        data at once, and a query being answered keeps the data it started with.
+
+        @param in the stream of queries
+        @param out the stream of answers
+        @param regions_path path to the file with the regions
+        @param routes_path path to the file with the routes
+        @param workers the threads to load the data and answer the queries on, or nullptr to stay on this thread
+        @return the latency of each query in milliseconds, from reading its last line to writing its END line
+    */
+    std::vector<double> serve(
+        std::istream& in,
+        std::ostream& out,
+        const std::string& regions_path,
+        const std::string& routes_path,
+        pool::Pool* workers = nullptr)
+    {
+        std::shared_ptr<const Data> current = load(cache::Key{cache::hash(regions_path), cache::hash(routes_path)},
+            regions_path, routes_path, workers);
+        if (not current) { exit(-1); }
+        std::thread loader;
+        std::vector<double> latencies;
+
+        auto line = [&](std::string& line)
+        {
+            if (not std::getline(in, line)) { return false; }
+            while (not line.empty() and isspace(line.back())) { line.pop_back(); }
+            return true;
+        };
+
+        std::string age_string;
+        while (line(age_string))
+        {
+            if (age_string.empty()) { continue; }
+            if (age_string == "RELOAD")
+            {
+                if (loader.joinable()) { loader.join(); }
+
+                // the loader stays off the pool, which the queries use meanwhile
+                loader = std::thread([&current, regions_path, routes_path]
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    if (not std::ifstream{regions_path}.is_open() or not std::ifstream{routes_path}.is_open())
+                    {
+                        std::clog << "Could not find the files to reload, keeping the old data" << std::endl;
+                        return;
+                    }
+                    cache::Key key {cache::hash(regions_path), cache::hash(routes_path)};
+                    auto old = std::atomic_load(&current);
+                    if (key.regions == old->key.regions and key.routes == old->key.routes)
+                    {
+                        std::clog << "The files have not changed, keeping the old data" << std::endl;
+                        return;
+                    }
+                    auto data = load(key, regions_path, routes_path);
+                    if (not data)
+                    {
+                        std::clog << "Could not reload the files, keeping the old data" << std::endl;
+                        return;
+                    }
+                    std::atomic_store(&current, data);
+                    std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+                    std::clog << "Reloading took " << time.count() << "ms" << std::endl;
+                });
+                continue;
+            }
+
+            std::string budget_string;
+            std::string active_path;
+            if (not line(budget_string) or not line(active_path)) { break; }
+            auto start = std::chrono::steady_clock::now();
+
+            double budget = 0.0;
+            std::array<double, intersection::TIMESLOTS> active_factors;
+            std::string error = server::error(age_string, budget_string, active_path, budget, active_factors);
+            if (not error.empty()) { out << "ERROR," << error << "\n"; }
+            else
+            {
+                std::shared_ptr<const Data> data = std::atomic_load(&current);
+                std::map<int, int> allocation;
+                server::answer(*data, parse::target_ages(age_string), active_factors, budget, allocation, workers);
+                for (const auto& iter : allocation)
+                {
+                    out << iter.first << "," << iter.second << "\n";
+                }
+            }
+            out << "END" << std::endl;
+
+            std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+            latencies.push_back(latency.count());
+        }
+
+        if (loader.joinable()) { loader.join(); }
+        return latencies;
+    }
+
+    /**
+        Answers a batch of queries from the resident data, sharing the work between queries with the same target
+        ages and activity probabilities: their benefits are computed once, and one dynamic programming table
+        up to their largest budget answers all their budgets, like the option --budgets does. These groups are
+        spread over the threads, the largest budgets first, and the answers are written in the order of the queries.
+        The queries and answers have the format of 'serve', without the line RELOAD.
+
+        @param in the stream of queries
+        @param out the stream of answers
+        @param data the resident data
+        @param workers the threads to answer the groups of queries on, or nullptr to stay on this thread
+        @return the number of groups of queries
+    */
+    size_t batch(std::istream& in, std::ostream& out, const Data& data, pool::Pool* workers = nullptr)
+    {
+        struct Query
+        {
+            double budget = 0.0;
+            std::string answer;
+        };
+
+        struct Group
+        {
+            std::string target_ages;
+            std::array<double, intersection::TIMESLOTS> active_factors;
+            double max_budget = 0.0;
+            std::vector<size_t> queries;
+        };
+
+        std::vector<Query> queries;
+        std::vector<Group> groups;
+        std::map<std::pair<std::string, std::string>, size_t> group_ids;
+        auto line = [&](std::string& line)
+        {
+            if (not std::getline(in, line)) { return false; }
+            while (not line.empty() and isspace(line.back())) { line.pop_back(); }
+            return true;
+        };
+
+        std::string age_string;
+        std::string budget_string;
+        std::string active_path;
+        while (line(age_string))
+        {
+            if (age_string.empty()) { continue; }
+            if (not line(budget_string) or not line(active_path)) { break; }
+
+            // the activity file is read here and not on the threads, so that an invalid one gives errors for its queries only
+            Query query;
+            std::array<double, intersection::TIMESLOTS> active_factors;
+            std::string error = server::error(age_string, budget_string, active_path, query.budget, active_factors);
+            queries.push_back(query);
+            if (not error.empty())
+            {
+                queries.back().answer = "ERROR," + error + "\n";
+                continue;
+            }
+
+            // the targets depend on the set of age groups only, not on their order
+            std::string target_ages = parse::target_ages(age_string);
+            std::sort(target_ages.begin(), target_ages.end());
+            target_ages.erase(std::unique(target_ages.begin(), target_ages.end()), target_ages.end());
+            auto inserted = group_ids.emplace(std::make_pair(target_ages, active_path), groups.size());
+            if (inserted.second) { groups.push_back(Group{target_ages, active_factors, 0.0, {}}); }
+
+            Group& group = groups[inserted.first->second];
+            group.max_budget = std::max(group.max_budget, query.budget);
+            group.queries.push_back(queries.size() - 1);
+        }
+
+        std::vector<size_t> order(groups.size());
+        for (size_t g = 0; g < order.size(); ++g) { order[g] = g; }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return groups[a].max_budget > groups[b].max_budget; });
+
+        auto answer = [&](size_t o)
+        {
+            const Group& group = groups[order[o]];
+            store::Store routes = store::routes(data.store);
+            store::benefits(routes, data.incidence, store::targets(data.store, group.target_ages, group.active_factors));
+            std::vector<std::unique_ptr<intersection::Route>> items;
+            store::items(routes, items);
+
+            knapsack::Table table;
+            if (not items.empty() and group.max_budget >= data.min_cost)
+            {
+                knapsack::solve(items, group.max_budget, data.cost_gcd, table);
+            }
+            for (auto q : group.queries)
+            {
+                std::map<int, int> allocation;
+                if (not items.empty() and queries[q].budget >= data.min_cost)
+                {
+                    knapsack::allocate(table, items, knapsack::units(queries[q].budget, data.cost_gcd), allocation);
+                }
+                for (const auto& iter : allocation)
+                {
+                    queries[q].answer += std::to_string(iter.first) + "," + std::to_string(iter.second) + "\n";
+                }
+            }
+        };
+
+        if (workers) { workers->run(order.size(), answer); }
+        else
+        {
+            for (size_t o = 0; o < order.size(); ++o) { answer(o); }
+        }
+
+        for (const auto& query : queries) { out << query.answer << "END\n"; }
+        out.flush();
+        return groups.size();
+    }
+
+    /**
+        Writes the number of queries and the percentiles of their latencies to the log.
+
+        @param latencies the latency of each query in milliseconds
+    */
+    void report(std::vector<double> latencies)
+    {
+        if (latencies.empty())
+        {
+            std::clog << "Answered no queries" << std::endl;
+            return;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p)
+        {
+            size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * latencies.size()));
+            return latencies[std::max<size_t>(rank, 1) - 1];
+        };
+        std::clog << "Answered " << latencies.size() << " queries, latency p50 " << percentile(50) << "ms, p90 "
+            << percentile(90) << "ms, p99 " << percentile(99) << "ms, max " << latencies.back() << "ms" << std::endl;
+    }
+}
@@ -0,0 +1,555 @@
+#pragma once
+
+namespace store
+{
+    /**
+        Represents a part of an array, starting at the offset and containing length entries.
+    */
+    struct Span
+    {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    /**
+        Represents which regions each route intersects as a sparse matrix in compressed sparse row format:
+        the regions intersected by the r-th route are columns[starts[r]] up to columns[starts[r+1]-1], in
+        ascending order, and each region is given by its ordinal among the region features of its file.
+    */
+    struct Incidence
+    {
+        std::vector<size_t> starts {0};
+        std::vector<uint32_t> columns;
+    };
+
+    /**
+        Represents all regions and routes with their geometry in a few flat arrays instead of one heap object
+        per feature. All the coordinates of all polygons and polylines follow each other in one arena of points,
+        and every feature refers to its part of the arena by a span. The boxes, targets and other properties
+        of the features sit in parallel arrays, so that the r-th entry of each region array belongs to the
+        r-th region, and likewise for routes and polylines.
+
+        The regions in the store may be only some of the region features of a file, and ordinals[r] is the number
+        of region features before the r-th region in its file, among region_features in total. The raw population
+        of all region features is kept by column: population[a*TIMESLOTS+t][n] is the number of people of age
+        group a+1 in time slot t in the n-th region feature, whatever the target ages.
+
+        The edges of all polygons follow each other in one structure of arrays, and the polylines of all routes
+        follow each other in one array of spans, each with its box and the span of its chunks' boxes. The benefits
+        of all routes follow each other in one array, and each route has the span of its maximum number of buses.
+    */
+    struct Store
+    {
+        std::vector<intersection::Point> points;
+
+        size_t region_features = 0;
+        std::vector<size_t> ordinals;
+        std::array<std::vector<double>, intersection::AGES * intersection::TIMESLOTS> population;
+        std::vector<int> mesh_ids;
+        std::vector<std::array<double, intersection::TIMESLOTS>> region_targets;
+        std::vector<intersection::Box> region_boxes;
+        std::vector<Span> polygons;
+        std::vector<Span> polygon_edges;
+        intersection::Edges edges;
+
+        std::vector<int> output_ids;
+        std::vector<double> costs;
+        std::vector<std::array<int, intersection::TIMESLOTS>> buses;
+        std::vector<intersection::Box> route_boxes;
+        std::vector<Span> route_polylines;
+        std::vector<std::array<double, intersection::TIMESLOTS>> route_targets;
+        std::vector<Span> route_benefits;
+        std::vector<double> benefits;
+
+        std::vector<Span> polylines;
+        std::vector<intersection::Box> polyline_boxes;
+        std::vector<Span> polyline_chunks;
+        std::vector<intersection::Box> chunk_boxes;
+    };
+
+    /**
+        Copies a region into the store.
+
+        @param store the store
+        @param region the region
+    */
+    void add(Store& store, const intersection::Region& region)
+    {
+        store.mesh_ids.push_back(region.meshId);
+        store.region_targets.push_back(region.targets);
+        store.region_boxes.push_back(region.box);
+
+        store.polygons.push_back(Span{store.points.size(), region.polygon.size()});
+        store.points.insert(store.points.end(), region.polygon.begin(), region.polygon.end());
+        store.polygon_edges.push_back(Span{store.edges.c_x.size(), 0});
+        intersection::split(region.polygon.data(), region.polygon.size(), store.edges);
+        store.polygon_edges.back().length = store.edges.c_x.size() - store.polygon_edges.back().offset;
+    }
+
+    /**
+        Copies a route into the store. The route's benefits are not copied, but the store reserves
+        room for the benefits of the route's maximum number of buses.
+
+        @param store the store
+        @param route the route
+    */
+    void add(Store& store, const intersection::Route& route)
+    {
+        store.output_ids.push_back(route.outputId);
+        store.costs.push_back(route.cost);
+        store.buses.push_back(route.buses);
+        store.route_boxes.push_back(route.box);
+        store.route_targets.push_back(route.targets);
+
+        auto maxBuses = std::max({route.buses[0], route.buses[1], route.buses[2], 0});
+        store.route_benefits.push_back(Span{store.benefits.size(), static_cast<size_t>(maxBuses)});
+        store.benefits.resize(store.benefits.size() + maxBuses, 0.0);
+
+        store.route_polylines.push_back(Span{store.polylines.size(), route.polylines.size()});
+        for (size_t p = 0; p < route.polylines.size(); ++p)
+        {
+            const auto& polyline = route.polylines[p];
+            store.polylines.push_back(Span{store.points.size(), polyline.size()});
+            store.points.insert(store.points.end(), polyline.begin(), polyline.end());
+
+            // routes parsed from incomplete lines may lack the box hierarchy of their last polyline
+            std::vector<intersection::Box> polyline_boxes;
+            std::vector<std::vector<intersection::Box>> chunk_boxes;
+            if (p >= route.chunk_boxes.size()) { intersection::bound(polyline, polyline_boxes, chunk_boxes); }
+            const auto& chunks = p < route.chunk_boxes.size() ? route.chunk_boxes[p] : chunk_boxes.back();
+
+            store.polyline_boxes.push_back(p < route.chunk_boxes.size() ? route.polyline_boxes[p] : polyline_boxes.back());
+            store.polyline_chunks.push_back(Span{store.chunk_boxes.size(), chunks.size()});
+            store.chunk_boxes.insert(store.chunk_boxes.end(), chunks.begin(), chunks.end());
+        }
+    }
+
+    /**
+        Appends the given values to a vector.
+
+        @param to the vector
+        @param from the values
+    */
+    template<typename Value>
+    void append(std::vector<Value>& to, const std::vector<Value>& from)
+    {
+        to.insert(to.end(), from.begin(), from.end());
+    }
+
+    /**
+        Appends spans to a vector of spans, moving each by the given offset.
+
+        @param to the vector of spans
+        @param from the spans
+        @param offset the offset to add to each span
+    */
+    void append(std::vector<Span>& to, const std::vector<Span>& from, size_t offset)
+    {
+        for (const auto& span : from) { to.push_back(Span{span.offset + offset, span.length}); }
+    }
+
+    /**
+        Appends all regions and routes of another store to the store, as if they had been added to the store
+        one after the other. The other store's region features follow the store's region features in their file.
+
+        @param store the store
+        @param part the other store
+    */
+    void append(Store& store, const Store& part)
+    {
+        size_t points = store.points.size();
+        size_t edges = store.edges.c_x.size();
+        size_t polylines = store.polylines.size();
+
+        for (auto ordinal : part.ordinals) { store.ordinals.push_back(store.region_features + ordinal); }
+        store.region_features += part.region_features;
+        for (size_t c = 0; c < store.population.size(); ++c) { append(store.population[c], part.population[c]); }
+        append(store.mesh_ids, part.mesh_ids);
+        append(store.region_targets, part.region_targets);
+        append(store.region_boxes, part.region_boxes);
+        append(store.polygons, part.polygons, points);
+        append(store.polygon_edges, part.polygon_edges, edges);
+        for (auto member : {&intersection::Edges::min_x, &intersection::Edges::max_x, &intersection::Edges::min_y,
+            &intersection::Edges::max_y, &intersection::Edges::c_x, &intersection::Edges::c_y, &intersection::Edges::d_x,
+            &intersection::Edges::d_y, &intersection::Edges::cd_x, &intersection::Edges::cd_y})
+        {
+            append(store.edges.*member, part.edges.*member);
+        }
+
+        append(store.output_ids, part.output_ids);
+        append(store.costs, part.costs);
+        append(store.buses, part.buses);
+        append(store.route_boxes, part.route_boxes);
+        append(store.route_polylines, part.route_polylines, polylines);
+        append(store.route_targets, part.route_targets);
+        append(store.route_benefits, part.route_benefits, store.benefits.size());
+        append(store.benefits, part.benefits);
+
+        append(store.polylines, part.polylines, points);
+        append(store.polyline_boxes, part.polyline_boxes);
+        append(store.polyline_chunks, part.polyline_chunks, store.chunk_boxes.size());
+        append(store.chunk_boxes, part.chunk_boxes);
+
+        append(store.points, part.points);
+    }
+
+    /**
+        Tests whether some polyline of the route intersects a polygon, given by its box and its edges.
+
+        @param store the store
+        @param route the index of the route
+        @param box the box of the polygon
+        @param edges the edges of some polygons
+        @param begin the first edge of the polygon
+        @param end the edge after the polygon's last edge
+        @param counters the counters of tests, or nullptr
+        @return true if the route intersects the polygon
+    */
+    bool must(
+        const Store& store,
+        size_t route,
+        const intersection::Box& box,
+        const intersection::Edges& edges,
+        size_t begin,
+        size_t end,
+        intersection::Counters* counters)
+    {
+        const Span& lines = store.route_polylines[route];
+        for (size_t p = lines.offset; p < lines.offset + lines.length; ++p)
+        {
+            if (not intersection::may(store.polyline_boxes[p], box)) { continue; }
+
+            const Span& polyline = store.polylines[p];
+            if (intersection::must(store.points.data() + polyline.offset, polyline.length,
+                store.chunk_boxes.data() + store.polyline_chunks[p].offset, box,
+                edges, begin, end, counters))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+        Tests whether some polyline of the route intersects the region's polygon, like intersection::must
+        does for a route and region as separate objects.
+
+        @param store the store
+        @param route the index of the route
+        @param region the index of the region
+        @param counters the counters of tests, or nullptr
+        @return true if the route intersects the region
+    */
+    bool must(const Store& store, size_t route, size_t region, intersection::Counters* counters)
+    {
+        const Span& edges = store.polygon_edges[region];
+        return store::must(store, route, store.region_boxes[region], store.edges, edges.offset, edges.offset + edges.length, counters);
+    }
+
+    /**
+        Computes the benefits of all routes in the store, which is done by computing all the intersections
+        between routes and regions. For a given route and region, we first check whether their boundary boxes
+        intersect, and only then look for a real intersection of their segments, see 'must'.
+
+        With an index, we do not even look at all the regions' boxes: If the regions form a uniform grid,
+        we only look at the regions in the grid cells covered by the route's segments. Otherwise, we look
+        for the regions whose boxes intersect the route's polylines' boxes in the R-tree of the regions.
+        The regions are visited in ascending order either way, so the benefits are exactly the same.
+
+        @param store the store with all regions and routes
+        @param index the index of all regions, or nullptr to look at all regions
+        @param counters the counters of tests, or nullptr
+        @param workers the threads to evaluate the routes in parallel, or nullptr to evaluate them on this thread
+        @param incidence this will store the regions each route intersects, or nullptr
+    */
+    void all(
+        Store& store,
+        const intersection::Index* index = nullptr,
+        intersection::Counters* counters = nullptr,
+        pool::Pool* workers = nullptr,
+        Incidence* incidence = nullptr)
+    {
+        std::vector<intersection::Counters> route_counters(counters ? store.output_ids.size() : 0);
+        std::vector<std::vector<uint32_t>> rows(incidence ? store.output_ids.size() : 0);
+        auto evaluate = [&](size_t r)
+        {
+            intersection::Counters* counted = counters ? &route_counters[r] : nullptr;
+            const auto& buses = store.buses[r];
+            const intersection::Box route_box = store.route_boxes[r];
+            const Span& lines = store.route_polylines[r];
+            const Span& benefits = store.route_benefits[r];
+            auto maxBuses = static_cast<int>(benefits.length);
+            std::fill(store.benefits.begin() + benefits.offset, store.benefits.begin() + benefits.offset + benefits.length, 0.0);
+            store.route_targets[r].fill(0.0);
+
+            const intersection::Box* boxes = store.region_boxes.data();
+            auto visit = [&](size_t region)
+            {
+                if (counted) { ++counted->may; }
+                if (not intersection::may(boxes[region], route_box)) { return; }
+
+                if (counted) { ++counted->must; }
+                if (store::must(store, r, region, counted))
+                {
+                    intersection::add(store.region_targets[region], buses, maxBuses,
+                        store.route_targets[r], store.benefits.data() + benefits.offset);
+                    if (incidence) { rows[r].push_back(store.ordinals[region]); }
+                }
+            };
+
+            bool use_grid = index and index->grid.uniform and not index->grid.cells.empty();
+            if (use_grid or (index and not index->tree.boxes.empty()))
+            {
+                std::vector<int> found;
+                for (size_t p = lines.offset; p < lines.offset + lines.length; ++p)
+                {
+                    if (use_grid)
+                    {
+                        intersection::candidates(index->grid, store.points.data() + store.polylines[p].offset, store.polylines[p].length, found);
+                    }
+                    else { intersection::query(index->tree, index->per_polyline ? store.polyline_boxes[p] : route_box, found); }
+                }
+                std::sort(found.begin(), found.end());
+                found.erase(std::unique(found.begin(), found.end()), found.end());
+                for (auto region : found) { visit(region); }
+                return;
+            }
+
+            for (size_t region = 0, regions = store.region_boxes.size(); region < regions; ++region) { visit(region); }
+        };
+
+        if (workers) { workers->run(store.output_ids.size(), evaluate); }
+        else
+        {
+            for (size_t r = 0; r < store.output_ids.size(); ++r) { evaluate(r); }
+        }
+
+        for (const auto& counted : route_counters)
+        {
+            counters->may += counted.may;
+            counters->must += counted.must;
+            counters->segments += counted.segments;
+        }
+
+        if (incidence)
+        {
+            *incidence = Incidence{};
+            for (const auto& row : rows)
+            {
+                incidence->columns.insert(incidence->columns.end(), row.begin(), row.end());
+                incidence->starts.push_back(incidence->columns.size());
+            }
+        }
+    }
+
+    /**
+        Computes the benefits of routes and regions given as separate objects, by copying them into a store.
+        The regions keep their indices, so an index of the regions can be used for the store.
+
+        @param regions all the regions
+        @param routes all the routes which we want to evaluate
+        @param index the index of all regions, or nullptr to look at all regions
+        @param counters the counters of tests, or nullptr
+        @param workers the threads to evaluate the routes in parallel, or nullptr to evaluate them on this thread
+    */
+    void all(
+        const std::vector<std::unique_ptr<intersection::Region>>& regions,
+        std::vector<std::unique_ptr<intersection::Route>>& routes,
+        const intersection::Index* index = nullptr,
+        intersection::Counters* counters = nullptr,
+        pool::Pool* workers = nullptr)
+    {
+        Store store;
+        for (const auto& region : regions) { store::add(store, *region); }
+        for (const auto& route : routes) { store::add(store, *route); }
+        store::all(store, index, counters, workers);
+
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            const Span& benefits = store.route_benefits[r];
+            routes[r]->benefits.assign(store.benefits.begin() + benefits.offset, store.benefits.begin() + benefits.offset + benefits.length);
+            routes[r]->targets = store.route_targets[r];
+        }
+    }
+
+    /**
+        Computes the targets of all region features for some target ages and activity probabilities from their
+        raw population, without parsing the regions again. The age groups are added in ascending order, like
+        they follow each other in the GeoJSON file, so the targets are exactly the parsed ones.
+
+        @param store the store with the population of all region features
+        @param target_ages contains the target age groups
+        @param active_factors activity probabilities, that is, expected ratio of people outside of buildings at different times
+        @return the targets of the n-th region feature at index n
+    */
+    std::vector<std::array<double, intersection::TIMESLOTS>> targets(
+        const Store& store,
+        const std::string& target_ages,
+        const std::array<double, intersection::TIMESLOTS>& active_factors)
+    {
+        std::vector<std::array<double, intersection::TIMESLOTS>> targets(store.region_features, {0., 0., 0.});
+        for (int a = 0; a < intersection::AGES; ++a)
+        {
+            if (std::find(target_ages.begin(), target_ages.end(), static_cast<char>('1' + a)) == target_ages.end()) { continue; }
+            for (int t = 0; t < intersection::TIMESLOTS; ++t)
+            {
+                const std::vector<double>& column = store.population[a*intersection::TIMESLOTS + t];
+                for (size_t n = 0; n < column.size(); ++n)
+                {
+                    targets[n][t] += column[n] * active_factors[t] * intersection::SLOT_LENGTHS[t];
+                }
+            }
+        }
+        return targets;
+    }
+
+    /**
+        Adds the targets of a region, which is not in the store, to the benefits of all routes in the store
+        which intersect it. The regions must be visited in the order of their file, as then every route
+        adds its regions in the same order as in 'all' and gets exactly the same benefits.
+
+        @param store the store with all routes
+        @param routes the R-tree over the boxes of the routes in the store
+        @param region the region
+        @param ordinal the number of region features before the region in its file
+        @param found the vector to use for the routes near the region, whose memory is reused
+        @param rows the regions each route intersects, by ordinal, or nullptr
+    */
+    void visit(
+        Store& store,
+        const intersection::RTree& routes,
+        const intersection::Region& region,
+        size_t ordinal,
+        std::vector<int>& found,
+        std::vector<std::vector<uint32_t>>* rows = nullptr)
+    {
+        found.clear();
+        intersection::query(routes, region.box, found);
+        for (auto r : found)
+        {
+            if (not store::must(store, r, region.box, region.edges, 0, region.edges.c_x.size(), nullptr)) { continue; }
+
+            const Span& benefits = store.route_benefits[r];
+            intersection::add(region.targets, store.buses[r], static_cast<int>(benefits.length),
+                store.route_targets[r], store.benefits.data() + benefits.offset);
+            if (rows) { (*rows)[r].push_back(ordinal); }
+        }
+    }
+
+    /**
+        Computes the benefits of all routes in the store from the regions they intersect, without any geometry.
+        This is a product of the sparse incidence matrix with the targets, and the regions are added
+        in the same order as in 'all', so the benefits are exactly the same. With the targets from
+        'targets', the benefits for other target ages need neither parsing nor intersections.
+
+        @param store the store with all routes
+        @param incidence the regions each route intersects
+        @param targets the targets of each region feature, by ordinal
+    */
+    void benefits(
+        Store& store,
+        const Incidence& incidence,
+        const std::vector<std::array<double, intersection::TIMESLOTS>>& targets)
+    {
+        for (size_t r = 0; r < store.output_ids.size(); ++r)
+        {
+            const Span& benefits = store.route_benefits[r];
+            std::fill(store.benefits.begin() + benefits.offset, store.benefits.begin() + benefits.offset + benefits.length, 0.0);
+            store.route_targets[r].fill(0.0);
+            for (size_t c = incidence.starts[r]; c < incidence.starts[r+1]; ++c)
+            {
+                intersection::add(targets[incidence.columns[c]], store.buses[r], static_cast<int>(benefits.length),
+                    store.route_targets[r], store.benefits.data() + benefits.offset);
+            }
+        }
+    }
+
+    /**
+        Copies the routes of the store without their geometry, that is, with their identifiers, costs, numbers
+        of buses, boxes, targets and benefits, so that 'benefits' and 'items' can be used on the copy.
+
+        @param store the store
+        @return the store with the routes only
+    */
+    Store routes(const Store& store)
+    {
+        Store routes;
+        routes.output_ids = store.output_ids;
+        routes.costs = store.costs;
+        routes.buses = store.buses;
+        routes.route_boxes = store.route_boxes;
+        routes.route_targets = store.route_targets;
+        routes.route_benefits = store.route_benefits;
+        routes.benefits = store.benefits;
+        return routes;
+    }
+
+    /**
+        Creates the routes as the knapsack solvers see them, that is, with their identifiers, costs,
+        numbers of buses, targets and benefits from the store, but without any geometry.
+
+        @param store the store whose benefits have been computed by 'all'
+        @param routes the vector to store the routes
+    */
+    void items(const Store& store, std::vector<std::unique_ptr<intersection::Route>>& routes)
+    {
+        routes.clear();
+        for (size_t r = 0; r < store.output_ids.size(); ++r)
+        {
+            auto route = std::make_unique<intersection::Route>();
+            route->outputId = store.output_ids[r];
+            route->cost = store.costs[r];
+            route->buses = store.buses[r];
+            route->targets = store.route_targets[r];
+            route->box = store.route_boxes[r];
+            const Span& benefits = store.route_benefits[r];
+            route->benefits.assign(store.benefits.begin() + benefits.offset, store.benefits.begin() + benefits.offset + benefits.length);
+            routes.push_back(std::move(route));
+        }
+    }
+
+    /**
+        Creates the regions and routes of the store as separate objects with their geometry, for looking
+        at single regions and routes. The r-th object is the r-th region or route of the store.
+
+        @param store the store
+        @param regions the vector to store the regions
+        @param routes the vector to store the routes
+    */
+    void objects(
+        const Store& store,
+        std::vector<std::unique_ptr<intersection::Region>>& regions,
+        std::vector<std::unique_ptr<intersection::Route>>& routes)
+    {
+        regions.clear();
+        for (size_t r = 0; r < store.region_boxes.size(); ++r)
+        {
+            auto region = std::make_unique<intersection::Region>();
+            region->meshId = store.mesh_ids[r];
+            region->targets = store.region_targets[r];
+            region->box = store.region_boxes[r];
+            const Span& polygon = store.polygons[r];
+            region->polygon.assign(store.points.begin() + polygon.offset, store.points.begin() + polygon.offset + polygon.length);
+            intersection::split(region->polygon, region->edges);
+            for (size_t c = 0; r < store.ordinals.size() and c < region->population.size(); ++c)
+            {
+                if (store.ordinals[r] < store.population[c].size()) { region->population[c] = store.population[c][store.ordinals[r]]; }
+            }
+            regions.push_back(std::move(region));
+        }
+
+        store::items(store, routes);
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            const Span& lines = store.route_polylines[r];
+            for (size_t p = lines.offset; p < lines.offset + lines.length; ++p)
+            {
+                const Span& polyline = store.polylines[p];
+                const Span& chunks = store.polyline_chunks[p];
+                routes[r]->polylines.emplace_back(store.points.begin() + polyline.offset, store.points.begin() + polyline.offset + polyline.length);
+                routes[r]->polyline_boxes.push_back(store.polyline_boxes[p]);
+                routes[r]->chunk_boxes.emplace_back(store.chunk_boxes.begin() + chunks.offset, store.chunk_boxes.begin() + chunks.offset + chunks.length);
+            }
+        }
+    }
+}
@@ -1,3 +1,3 @@
 #!/bin/bash
 
-clang++ -Wall -Wextra -O2 -std=c++14 -o test test_Main.cpp
+clang++ -Wall -Wextra -O2 -std=c++14 -pthread -o test test_Main.cpp -lz "$@"
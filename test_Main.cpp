@@ -1,10 +1,39 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <unordered_map>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef LIBZSTD
+#include <zstd.h>
+#endif
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#include <immintrin.h>
+#endif
 
 /**
     Returns the number of milliseconds since the given timestamp.
@@ -17,12 +46,51 @@ double since(clock_t start)
     return 1000.*double(clock() - start) / CLOCKS_PER_SEC;
 }
 
+#include "pool.hpp"
+
 #include "intersection.hpp"
 
+#include "store.hpp"
+
+#include "dataset.hpp"
+
+#include "compressed.hpp"
+
 #include "knapsack.hpp"
 
 #include "parse.hpp"
 
+#include "cache.hpp"
+
+#include "server.hpp"
+
+/**
+    Checks that the given allocation fits into the budget and reaches the given value.
+
+    @param routes the vector with the routes
+    @param allocation the allocation to check
+    @param budget the total given budget
+    @param value the value the allocation should reach
+    @return true if the allocation is affordable and reaches the value
+*/
+bool affordable(
+    const std::vector<std::unique_ptr<intersection::Route>>& routes,
+    const std::map<int, int>& allocation,
+    const double& budget,
+    const double& value)
+{
+    double spent = 0.0;
+    double reached = 0.0;
+    for (auto& route : routes)
+    {
+        auto count = allocation.find(route->outputId);
+        if (count == allocation.end()) { continue; }
+        spent += count->second*route->cost;
+        reached += route->benefits[count->second-1];
+    }
+    return spent <= budget and std::abs(reached - value) <= 1e-9*value;
+}
+
 void run(
     const std::string& age_string,
     const std::string& budget_string,
@@ -42,14 +110,78 @@ void run(
     std::vector<std::unique_ptr<intersection::Region>> regions;
     std::vector<std::unique_ptr<intersection::Route>> routes;
     double budget;
-    double cost_gcd;
+    double cost_gcd {0.0};
     double min_cost {std::numeric_limits<double>::infinity()};
     std::map<int, int> allocation;
+    intersection::Index index;
 
     parse::input(regions, routes, budget, min_cost, cost_gcd,
-        age_string, budget_string, regions_path, routes_path, active_path);
+        age_string, budget_string, regions_path, routes_path, active_path, &index);
 
-    intersection::all(regions, routes);
+    std::vector<std::vector<double>> scanned;
+    store::all(regions, routes);
+    for (auto& route : routes) { scanned.push_back(route->benefits); }
+
+    // testing all segments of the routes must find the same intersections as the box hierarchy
+    for (auto& route : routes)
+    {
+        intersection::Route flat = *route;
+        flat.polyline_boxes.clear();
+        flat.chunk_boxes.clear();
+        for (auto& region : regions)
+        {
+            if (route->polyline_boxes.size() != route->polylines.size()
+                or intersection::must(*route, *region, nullptr) != intersection::must(flat, *region, nullptr))
+            {
+                std::clog << "FAILED! The box hierarchy gives different intersections for route " << route->outputId << std::endl;
+                exit(-1);
+            }
+        }
+    }
+
+    // the regions form a grid, but the R-tree must find the same intersections
+    intersection::Index tree_index;
+    std::vector<intersection::Box> boxes;
+    for (auto& region : regions) { boxes.push_back(region->box); }
+    intersection::build(tree_index.tree, boxes);
+
+    for (const intersection::Index* used : {&tree_index, &index})
+    {
+        store::all(regions, routes, used);
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            if (not index.grid.uniform or routes[r]->benefits != scanned[r])
+            {
+                std::clog << "FAILED! The " << (used == &index ? "grid" : "R-tree") << " of regions gives different benefits for route "
+                    << routes[r]->outputId << std::endl;
+                exit(-1);
+            }
+        }
+    }
+
+    // the store must give the same benefits as its regions and routes copied out as objects
+    store::Store store;
+    intersection::Index store_index;
+    double store_budget;
+    double store_gcd {0.0};
+    double store_min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(store, store_budget, store_min_cost, store_gcd,
+        age_string, budget_string, regions_path, routes_path, active_path, &store_index);
+    std::vector<std::unique_ptr<intersection::Route>> items;
+    for (const intersection::Index* used : std::vector<const intersection::Index*>{nullptr, &store_index})
+    {
+        store::all(store, used);
+        store::items(store, items);
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            if (items.size() != routes.size() or items[r]->outputId != routes[r]->outputId or items[r]->benefits != scanned[r]
+                or store.region_boxes.size() != regions.size() or store_gcd != cost_gcd or store_min_cost != min_cost)
+            {
+                std::clog << "FAILED! The store gives different benefits for route " << routes[r]->outputId << std::endl;
+                exit(-1);
+            }
+        }
+    }
 
     double value = knapsack::optimize(routes, budget, min_cost, cost_gcd, allocation);
 
@@ -61,7 +193,31 @@ void run(
     }
     std::clog << "(The allocation's value is " << value << ")\n";
 
+    knapsack::Memory memory;
+    std::map<int, int> linear_allocation;
+    double linear_value = knapsack::optimize_linear(routes, budget, min_cost, cost_gcd, linear_allocation, memory);
+    if (linear_value != value or !affordable(routes, linear_allocation, budget, value))
+    {
+        std::clog << "FAILED! The linear-memory solver found value " << linear_value << " with an allocation not reaching it";
+        std::clog << std::endl;
+        exit(-1);
+    }
+
     const double EPSILON = 1e-2;
+    for (double epsilon : {0.2, 0.05})
+    {
+        std::map<int, int> approximate_allocation;
+        double upper_bound;
+        double approximate_value = knapsack::approximate(routes, budget, epsilon, approximate_allocation, upper_bound);
+        if (approximate_value < (1.0 - epsilon)*correct_value - EPSILON or approximate_value > correct_value + EPSILON
+            or upper_bound < correct_value - EPSILON)
+        {
+            std::clog << "FAILED! The approximation with epsilon " << epsilon << " has value " << approximate_value
+                << " and upper bound " << upper_bound << ", but the optimum is " << correct_value << std::endl;
+            exit(-1);
+        }
+    }
+
     if (value >= correct_value - EPSILON and value <= correct_value + EPSILON)
     {
         std::clog << "PASSED!\n";
@@ -76,6 +232,1103 @@ void run(
     }
 }
 
+/**
+    Checks that a table filled once for the greatest budget gives the same allocations for smaller
+    budgets as solving for each of them separately, and that its curve agrees with those values.
+*/
+void frontier()
+{
+    std::vector<std::unique_ptr<intersection::Region>> regions;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(regions, routes, budget, min_cost, cost_gcd,
+        "1, 2, 3, 6", "30000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+    store::all(regions, routes);
+
+    knapsack::Table table;
+    knapsack::solve(routes, budget, cost_gcd, table);
+    std::vector<std::pair<double, double>> curve;
+    knapsack::frontier(table, curve);
+
+    for (double listed : {1200000.0, 2500000.0, 10000000.0, 30000000.0})
+    {
+        std::map<int, int> allocation;
+        double value = knapsack::optimize(routes, listed, min_cost, cost_gcd, allocation);
+
+        std::map<int, int> listed_allocation;
+        double listed_value = knapsack::allocate(table, routes, knapsack::units(listed, cost_gcd), listed_allocation);
+
+        auto point = std::upper_bound(curve.begin(), curve.end(), std::make_pair(listed, std::numeric_limits<double>::infinity()));
+        if (listed_value != value or listed_allocation != allocation or (point-1)->second != value)
+        {
+            std::clog << "FAILED! The frontier does not agree with solving for budget " << listed << std::endl;
+            exit(-1);
+        }
+    }
+    std::clog << "Frontier PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the linear-memory solver finds an optimal allocation where several allocations tie,
+    even when it is not the one walking back through the table gives.
+*/
+void ties()
+{
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    for (auto item : {std::make_pair(1.0, 0.0), std::make_pair(2.0, 10.0), std::make_pair(1.0, 10.0),
+        std::make_pair(1.0, 10.0), std::make_pair(2.0, 20.0), std::make_pair(3.0, 10.0)})
+    {
+        routes.push_back(std::make_unique<intersection::Route>());
+        routes.back()->outputId = static_cast<int>(routes.size());
+        routes.back()->cost = item.first;
+        routes.back()->benefits = {item.second};
+    }
+
+    for (size_t count : {3, 6})
+    {
+        std::vector<std::unique_ptr<intersection::Route>> tied;
+        for (size_t r = 0; r < count; ++r) { tied.push_back(std::make_unique<intersection::Route>(*routes[r])); }
+        for (double budget : {1.0, 2.0, 3.0, 4.0, 5.0})
+        {
+            std::map<int, int> allocation;
+            double value = knapsack::optimize(tied, budget, 1.0, 1.0, allocation);
+
+            knapsack::Memory memory;
+            std::map<int, int> linear_allocation;
+            double linear_value = knapsack::optimize_linear(tied, budget, 1.0, 1.0, linear_allocation, memory);
+            if (linear_value != value or !affordable(tied, allocation, budget, value)
+                or !affordable(tied, linear_allocation, budget, value))
+            {
+                std::clog << "FAILED! With " << count << " tied routes and budget " << budget << ", the table gives "
+                    << value << " and the linear-memory solver " << linear_value << std::endl;
+                exit(-1);
+            }
+        }
+    }
+    std::clog << "Ties PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that computing the rows of the table on several threads gives exactly the same table.
+*/
+void threads()
+{
+    std::vector<std::unique_ptr<intersection::Region>> regions;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(regions, routes, budget, min_cost, cost_gcd,
+        "1, 2, 3, 4, 5, 6", "10000000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+    store::all(regions, routes);
+    std::vector<std::vector<double>> benefits;
+    for (auto& route : routes) { benefits.push_back(route->benefits); }
+
+    pool::Pool workers {4};
+    store::all(regions, routes, nullptr, nullptr, &workers);
+    for (size_t r = 0; r < routes.size(); ++r)
+    {
+        if (routes[r]->benefits != benefits[r])
+        {
+            std::clog << "FAILED! The benefits computed on " << workers.size() << " threads differ for route "
+                << routes[r]->outputId << std::endl;
+            exit(-1);
+        }
+    }
+
+    knapsack::Table serial;
+    knapsack::solve(routes, budget, cost_gcd, serial);
+
+    knapsack::Table parallel;
+    knapsack::solve(routes, budget, cost_gcd, parallel, &workers);
+
+    if (parallel.values != serial.values)
+    {
+        std::clog << "FAILED! The table computed on " << workers.size() << " threads differs" << std::endl;
+        exit(-1);
+    }
+    std::clog << "Threads PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the specialised update for concave benefits computes the same cells as trying every
+    number of buses, on routes with many buses like the ones store::all produces.
+*/
+void concave()
+{
+    intersection::Route route;
+    route.buses = {40, 25, 3};
+    const std::array<double, intersection::TIMESLOTS> targets {7.0, 120.0, 33.0};
+    route.benefits.assign(40, 0.0);
+    for (int s = 0; s < intersection::TIMESLOTS; ++s)
+    {
+        for (int b = 0; b < 40; ++b) { route.benefits[b] += std::min(b+1, route.buses[s])*targets[s]; }
+    }
+
+    const size_t columns = 5000;
+    std::vector<double> previous(columns);
+    for (size_t u = 0; u < columns; ++u) { previous[u] = static_cast<double>((u*7919) % 10007 + u*3); }
+
+    for (size_t cost_units : {1, 3, 7, 250})
+    {
+        for (auto range : {std::make_pair<size_t, size_t>(0, 5000), std::make_pair<size_t, size_t>(1234, 3001)})
+        {
+            std::vector<double> generic(columns, -1.0);
+            std::vector<double> specialised(columns, -1.0);
+            knapsack::cells(route, cost_units, previous.data(), generic.data(), range.first, range.second, knapsack::maxplus_scalar);
+            knapsack::concave_cells(route, cost_units, previous.data(), specialised.data(), range.first, range.second);
+            if (generic != specialised)
+            {
+                std::clog << "FAILED! The concave update differs for cost " << cost_units << std::endl;
+                exit(-1);
+            }
+        }
+    }
+
+    route.benefits[20] += 1000.0;
+    if (!knapsack::concave(intersection::Route()) or knapsack::concave(route))
+    {
+        std::clog << "FAILED! Concavity of benefits is not recognized" << std::endl;
+        exit(-1);
+    }
+    std::clog << "Concave PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that re-optimizing after a single route change finds an allocation as good as solving
+    the changed problem from scratch.
+*/
+void whatif()
+{
+    std::vector<std::unique_ptr<intersection::Region>> regions;
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(regions, routes, budget, min_cost, cost_gcd,
+        "1, 2, 3, 6", "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+    store::all(regions, routes);
+
+    knapsack::WhatIf what_if;
+    knapsack::prepare(routes, budget, cost_gcd, what_if);
+
+    for (size_t edit = 0; edit < 4; ++edit)
+    {
+        size_t index = (edit*53 + 11) % routes.size();
+        intersection::Route changed = *routes[index];
+        if (edit == 0) { changed.cost *= 0.9; }
+        if (edit == 1) { changed.buses[1] = 0; intersection::benefits(changed); }
+        if (edit == 2) { for (auto& benefit : changed.benefits) { benefit *= 3.0; } }
+        if (edit == 3) { changed.cost = 300000; changed.buses = {3, 3, 3}; intersection::benefits(changed); }
+
+        std::map<int, int> allocation;
+        double value = knapsack::reoptimize(what_if, routes, index, changed, allocation);
+
+        std::vector<std::unique_ptr<intersection::Route>> changed_routes;
+        double changed_gcd {0.0};
+        double changed_min_cost {std::numeric_limits<double>::infinity()};
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            changed_routes.push_back(std::make_unique<intersection::Route>(r == index ? changed : *routes[r]));
+            changed_gcd = knapsack::compute_gcd(static_cast<int>(changed_gcd), static_cast<int>(changed_routes.back()->cost));
+            changed_min_cost = std::min(changed_min_cost, changed_routes.back()->cost);
+        }
+        std::map<int, int> solved_allocation;
+        double solved_value = knapsack::optimize(changed_routes, budget, changed_min_cost, changed_gcd, solved_allocation);
+
+        double spent = 0.0;
+        double reached = 0.0;
+        for (auto& route : changed_routes)
+        {
+            if (allocation.count(route->outputId) == 0) { continue; }
+            spent += allocation[route->outputId]*route->cost;
+            reached += route->benefits[allocation[route->outputId]-1];
+        }
+        if (std::abs(value - solved_value) > 1e-9*solved_value or std::abs(reached - value) > 1e-9*value or spent > budget)
+        {
+            std::clog << "FAILED! Re-optimizing edit " << edit << " gives " << value << " (reaching " << reached
+                << " for " << spent << "), but solving again gives " << solved_value << std::endl;
+            exit(-1);
+        }
+    }
+
+    std::map<int, int> allocation;
+    if (knapsack::reoptimize(what_if, routes, routes.size(), *routes.back(), allocation) != 0.0 or not allocation.empty())
+    {
+        std::clog << "FAILED! Re-optimizing a route past the last one allocates buses" << std::endl;
+        exit(-1);
+    }
+    std::clog << "What-if PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the edge kernels give exactly the same answers as testing every edge with 'must',
+    on segments and polygons with many collinear and touching edges and determinants near EPSILON.
+*/
+void edges()
+{
+    unsigned long long state = 12345;
+    auto coordinate = [&state]()
+    {
+        state = state*6364136223846793005ULL + 1442695040888963407ULL;
+        double lattice = static_cast<double>((state >> 33) % 5);
+        double nudge = static_cast<double>(static_cast<long long>((state >> 20) % 5) - 2) * 3e-13;
+        return lattice + ((state >> 40) % 3 == 0 ? nudge : 0.0);
+    };
+
+    std::vector<intersection::EdgeKernel> kernels {intersection::edges_scalar, intersection::edge_kernel()};
+    for (int test = 0; test < 20000; ++test)
+    {
+        std::vector<intersection::Point> polygon;
+        for (int p = 0, size = 2 + test % 11; p < size; ++p) { polygon.push_back(intersection::Point{coordinate(), coordinate()}); }
+        polygon.push_back(polygon.front());
+        intersection::Edges split;
+        intersection::split(polygon, split);
+
+        intersection::Point a {coordinate(), coordinate()};
+        intersection::Point b {coordinate(), coordinate()};
+        bool expected = intersection::must(a, b, polygon);
+        for (auto kernel : kernels)
+        {
+            if (kernel(a, b, split, 0, split.c_x.size()) != expected)
+            {
+                std::clog << "FAILED! An edge kernel disagrees with 'must' on test " << test << std::endl;
+                exit(-1);
+            }
+        }
+    }
+    std::clog << "Edges PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that a warm start from the cache file gives exactly the same benefits as the cold start
+    that wrote it, with other ages too, and that damaged or outdated cache files are rejected.
+*/
+void cached()
+{
+    std::string path = "./test.cache";
+    std::remove(path.c_str());
+    for (std::string age_string : {"1, 2, 3, 4, 5, 6", "1, 3"})
+    {
+        store::Store cold;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(cold, budget, min_cost, cost_gcd,
+            age_string, "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+        store::all(cold);
+
+        store::Store warm;
+        double warm_budget;
+        double warm_gcd {0.0};
+        double warm_min_cost {std::numeric_limits<double>::infinity()};
+        cache::input(path, warm, warm_budget, warm_min_cost, warm_gcd,
+            age_string, "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+        bool used = cache::input(path, warm, warm_budget, warm_min_cost, warm_gcd,
+            age_string, "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+
+        if (not used or warm.benefits != cold.benefits or warm.route_targets != cold.route_targets
+            or warm_min_cost != min_cost or warm_gcd != cost_gcd or warm_budget != budget)
+        {
+            std::clog << "FAILED! The warm start from the cache differs from the cold start" << std::endl;
+            exit(-1);
+        }
+    }
+
+    cache::Key key {cache::hash("./data/Population_1.geojson"), cache::hash("./data/Route.geojson")};
+    store::Incidence incidence;
+    size_t features = 0;
+    cache::Key outdated {key.regions, key.routes + 1};
+    if (not cache::load(path, key, features, incidence) or cache::load(path, outdated, features, incidence))
+    {
+        std::clog << "FAILED! The cache file is not validated against the hashes of the files" << std::endl;
+        exit(-1);
+    }
+
+    std::string bytes;
+    {
+        std::ifstream stream {path, std::ios::binary};
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+    for (size_t pos : {size_t(0), bytes.size() / 2, bytes.size() - 1})
+    {
+        std::string damaged = bytes;
+        damaged[pos] ^= 0x10;
+        for (const std::string& written : {damaged, bytes.substr(0, pos)})
+        {
+            std::ofstream stream {path, std::ios::binary | std::ios::trunc};
+            stream.write(written.data(), written.size());
+            stream.close();
+            if (cache::load(path, key, features, incidence))
+            {
+                std::clog << "FAILED! A damaged cache file at byte " << pos << " is accepted" << std::endl;
+                exit(-1);
+            }
+        }
+    }
+    std::remove(path.c_str());
+    std::clog << "Cache PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the benefits computed from the raw population and the incidence matrix for other target ages
+    are exactly the ones of parsing the regions for those ages and intersecting them again.
+*/
+void ages()
+{
+    store::Store store;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(store, budget, min_cost, cost_gcd,
+        "1, 2, 3, 4, 5, 6", "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+    store::Incidence incidence;
+    store::all(store, nullptr, nullptr, nullptr, &incidence);
+    auto active_factors = parse::active_factors("./data/active.csv");
+
+    for (std::string age_string : {"1, 2, 5", "6", "1, 3, 5", "2, 4, 6", "1, 2, 3, 4, 5, 6"})
+    {
+        store::Store parsed;
+        parse::input(parsed, budget, min_cost, cost_gcd,
+            age_string, "10000000", "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+        store::all(parsed);
+
+        auto targets = store::targets(store, parse::target_ages(age_string), active_factors);
+        store::benefits(store, incidence, targets);
+        bool same = store.benefits == parsed.benefits and store.route_targets == parsed.route_targets;
+        for (size_t r = 0; r < parsed.ordinals.size(); ++r) { same = same and targets[parsed.ordinals[r]] == parsed.region_targets[r]; }
+        if (not same)
+        {
+            std::clog << "FAILED! The benefits from the population differ from parsing the ages " << age_string << std::endl;
+            exit(-1);
+        }
+    }
+    std::clog << "Ages PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the lines of a mapped file are the ones std::getline reads, with and without a final newline.
+*/
+void lines()
+{
+    std::string path = "./test.lines";
+    for (std::string contents : {"", "\n", "first\n\nthird", "first\nsecond\n", "{\"type\": \"Feature\"}\r\n"})
+    {
+        {
+            std::ofstream stream {path, std::ios::binary | std::ios::trunc};
+            stream << contents;
+        }
+        std::vector<std::string> expected;
+        std::ifstream stream {path};
+        for (std::string line; std::getline(stream, line);) { expected.push_back(line); }
+
+        std::vector<std::string> mapped;
+        parse::Mapping file {path};
+        const char* pos = file.begin();
+        const char* first;
+        const char* last;
+        while (file.is_open() and parse::next_line(pos, file.end(), first, last)) { mapped.emplace_back(first, last); }
+        if (not file.is_open() or mapped != expected)
+        {
+            std::clog << "FAILED! The mapped file has other lines than std::getline reads" << std::endl;
+            exit(-1);
+        }
+    }
+    std::remove(path.c_str());
+    if (parse::Mapping{path}.is_open())
+    {
+        std::clog << "FAILED! A missing file can be mapped" << std::endl;
+        exit(-1);
+    }
+    std::clog << "Lines PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that parsing the files in chunks on several threads gives exactly the same store and grid
+    as parsing them on one thread, with the features in the order of the files.
+*/
+void chunked()
+{
+    auto same = [](const store::Store& a, const store::Store& b)
+    {
+        auto spans = [](const std::vector<store::Span>& x, const std::vector<store::Span>& y)
+        {
+            return x.size() == y.size() and std::equal(x.begin(), x.end(), y.begin(),
+                [](const store::Span& s, const store::Span& t) { return s.offset == t.offset and s.length == t.length; });
+        };
+        return a.points == b.points and a.region_features == b.region_features and a.ordinals == b.ordinals
+            and a.population == b.population and a.mesh_ids == b.mesh_ids and a.region_targets == b.region_targets
+            and a.region_boxes == b.region_boxes and spans(a.polygons, b.polygons) and spans(a.polygon_edges, b.polygon_edges)
+            and a.edges.c_x == b.edges.c_x and a.edges.cd_y == b.edges.cd_y and a.edges.min_x == b.edges.min_x
+            and a.output_ids == b.output_ids and a.costs == b.costs and a.buses == b.buses and a.route_boxes == b.route_boxes
+            and spans(a.route_polylines, b.route_polylines) and spans(a.route_benefits, b.route_benefits)
+            and spans(a.polylines, b.polylines) and a.polyline_boxes == b.polyline_boxes
+            and spans(a.polyline_chunks, b.polyline_chunks) and a.chunk_boxes == b.chunk_boxes;
+    };
+
+    store::Store serial;
+    intersection::Index serial_index;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(serial, budget, min_cost, cost_gcd, "1, 2, 3, 4, 5, 6", "10000000",
+        "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &serial_index);
+
+    for (size_t threads : {2, 3, 8})
+    {
+        pool::Pool workers {threads};
+        store::Store parallel;
+        intersection::Index parallel_index;
+        double parallel_gcd {0.0};
+        double parallel_min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(parallel, budget, parallel_min_cost, parallel_gcd, "1, 2, 3, 4, 5, 6", "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &parallel_index, &workers);
+
+        if (not same(serial, parallel) or parallel_gcd != cost_gcd or parallel_min_cost != min_cost
+            or parallel_index.grid.cells != serial_index.grid.cells)
+        {
+            std::clog << "FAILED! Parsing on " << threads << " threads gives another store" << std::endl;
+            exit(-1);
+        }
+    }
+    std::clog << "Chunked PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the binary datasets converted from the GeoJSON files give exactly the same benefits as
+    the GeoJSON files for several target ages, and that damaged binary datasets are rejected.
+*/
+void binary()
+{
+    std::string regions_path = "./test.regions";
+    std::string routes_path = "./test.routes";
+    {
+        store::Store store;
+        intersection::Box everywhere {intersection::infimum, intersection::supremum};
+        parse::all_regions(store, "", {0., 0., 0.}, everywhere, "./data/Population_1.geojson");
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        parse::all_routes(store, min_cost, cost_gcd, routes_boundary, "./data/Route.geojson");
+        if (not dataset::save_regions(regions_path, store) or not dataset::save_routes(routes_path, store))
+        {
+            std::clog << "FAILED! The binary datasets could not be written" << std::endl;
+            exit(-1);
+        }
+    }
+
+    for (std::string age_string : {"1, 2, 5", "6", "1, 2, 3, 4, 5, 6"})
+    {
+        store::Store text;
+        intersection::Index text_index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(text, budget, min_cost, cost_gcd, age_string, "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &text_index);
+        store::all(text, &text_index);
+
+        store::Store binary;
+        intersection::Index binary_index;
+        double binary_gcd {0.0};
+        double binary_min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(binary, budget, binary_min_cost, binary_gcd, age_string, "10000000",
+            regions_path, routes_path, "./data/active.csv", &binary_index);
+        store::all(binary, &binary_index);
+
+        if (binary.benefits != text.benefits or binary.region_targets != text.region_targets or binary.ordinals != text.ordinals
+            or binary.points != text.points or binary.chunk_boxes != text.chunk_boxes or binary.edges.cd_x != text.edges.cd_x
+            or binary_gcd != cost_gcd or binary_min_cost != min_cost)
+        {
+            std::clog << "FAILED! The binary datasets differ from the GeoJSON files for the ages " << age_string << std::endl;
+            exit(-1);
+        }
+    }
+
+    std::string bytes;
+    {
+        std::ifstream stream {regions_path, std::ios::binary};
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+    store::Store store;
+    intersection::Box everywhere {intersection::infimum, intersection::supremum};
+    if (not dataset::regions(store, bytes.data(), bytes.data() + bytes.size(), "1", {1., 1., 1.}, everywhere)
+        or dataset::routes(store, bytes.data(), bytes.data() + bytes.size()))
+    {
+        std::clog << "FAILED! The binary dataset of regions is not read as regions only" << std::endl;
+        exit(-1);
+    }
+    for (size_t pos : {size_t(0), size_t(40), bytes.size() / 2, bytes.size() - 1})
+    {
+        std::string damaged = bytes;
+        damaged[pos] ^= 0x10;
+        for (const std::string& read : {damaged, bytes.substr(0, pos / 8 * 8)})
+        {
+            if (dataset::regions(store, read.data(), read.data() + read.size(), "1", {1., 1., 1.}, everywhere))
+            {
+                std::clog << "FAILED! A damaged binary dataset at byte " << pos << " is accepted" << std::endl;
+                exit(-1);
+            }
+        }
+    }
+    std::remove(regions_path.c_str());
+    std::remove(routes_path.c_str());
+    std::clog << "Binary PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that parse::double_number gives exactly the double strtod gives, on every number in the example
+    files and on many random numbers: printed doubles, long fractions, halfway cases and exponents.
+*/
+void doubles()
+{
+    auto check = [](const std::string& text)
+    {
+        double parsed = -1.0;
+        auto pos = text.cbegin();
+        parse::double_number(parsed, pos, text.cend());
+        double expected = std::strtod(text.c_str(), nullptr);
+        if (std::memcmp(&parsed, &expected, sizeof(double)) != 0 or pos != text.cend())
+        {
+            std::clog.precision(std::numeric_limits<double>::max_digits10);
+            std::clog << "FAILED! The text " << text << " is parsed as " << parsed << ", but strtod gives " << expected << std::endl;
+            exit(-1);
+        }
+    };
+
+    size_t numbers = 0;
+    for (std::string filename : {"./data/Population_1.geojson", "./data/Route.geojson"})
+    {
+        std::ifstream stream {filename};
+        std::string contents {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        for (size_t pos = 0; pos < contents.size();)
+        {
+            if (not (contents[pos] >= '0' and contents[pos] <= '9')) { ++pos; continue; }
+            size_t end = contents.find_first_not_of("0123456789.", pos);
+            check(contents.substr(pos, end - pos));
+            ++numbers;
+            pos = end;
+        }
+    }
+
+    unsigned long long state = 4321;
+    auto random = [&state]()
+    {
+        state = state*6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 11;
+    };
+    char text[64];
+    for (int test = 0; test < 1000000; ++test, ++numbers)
+    {
+        switch (test % 5)
+        {
+        case 0: // a double printed with all its digits
+        {
+            double value = static_cast<double>(random()) / static_cast<double>(random() | 1) * std::pow(10.0, static_cast<int>(random() % 40) - 20);
+            std::snprintf(text, sizeof(text), "%.17g", value);
+            break;
+        }
+        case 1: // a coordinate with up to 19 significant digits
+            std::snprintf(text, sizeof(text), "%llu.%0*llu", random() % 1000, static_cast<int>(1 + random() % 16),
+                random() % 10000000000000000ULL);
+            break;
+        case 2: // more than 19 significant digits, which strtod parses
+            std::snprintf(text, sizeof(text), "%llu.%llu%llu", random() % 1000, random(), random());
+            break;
+        case 3: // a decimal halfway between two doubles
+        {
+            double value = static_cast<double>(random() % (1ULL << 53)) * std::pow(2.0, static_cast<int>(random() % 40) - 20);
+            double next = std::nextafter(value, std::numeric_limits<double>::infinity());
+            std::snprintf(text, sizeof(text), "%.25g", value + (next - value) / 2);
+            break;
+        }
+        default: // an exponent
+            std::snprintf(text, sizeof(text), "%llu.%llue%d", random() % 100000, random() % 100000,
+                static_cast<int>(random() % 700) - 350);
+        }
+        check(text);
+    }
+    check("0");
+    check("0.0");
+    check("0.000000000000000000000000000001");
+    check("9007199254740993");
+    check("139.850545579999988");
+    std::clog << "Doubles PASSED! (" << numbers << " numbers)\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that streaming the regions through the routes gives exactly the same benefits and the same
+    regions of each route as intersecting the stored regions, for several target ages.
+*/
+void streamed()
+{
+    for (std::string age_string : {"1, 2, 5", "6", "1, 2, 3, 4, 5, 6"})
+    {
+        store::Store stored;
+        intersection::Index index;
+        store::Incidence incidence;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(stored, budget, min_cost, cost_gcd, age_string, "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &index);
+        store::all(stored, &index, nullptr, nullptr, &incidence);
+
+        store::Store streamed;
+        double stream_gcd {0.0};
+        double stream_min_cost {std::numeric_limits<double>::infinity()};
+        intersection::Box routes_boundary {intersection::supremum, intersection::infimum};
+        parse::all_routes(streamed, stream_min_cost, stream_gcd, routes_boundary, "./data/Route.geojson");
+        store::Incidence streamed_incidence;
+        parse::stream_regions(streamed, parse::target_ages(age_string), parse::active_factors("./data/active.csv"),
+            routes_boundary, "./data/Population_1.geojson", &streamed_incidence);
+
+        if (streamed.benefits != stored.benefits or streamed.route_targets != stored.route_targets
+            or streamed.region_features != stored.region_features or not streamed.region_boxes.empty()
+            or streamed_incidence.starts != incidence.starts or streamed_incidence.columns != incidence.columns)
+        {
+            std::clog << "FAILED! The streamed regions differ from the stored regions for the ages " << age_string << std::endl;
+            exit(-1);
+        }
+    }
+    std::clog << "Streamed PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that parsing the regions lazily gives exactly the same benefits as parsing all of them, for several
+    target ages, and that the regions without targets are left out, both in the store and when streaming.
+*/
+void lazy()
+{
+    for (std::string age_string : {"1, 2, 5", "2", "1, 2, 3, 4, 5, 6"})
+    {
+        store::Store full;
+        intersection::Index full_index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(full, budget, min_cost, cost_gcd, age_string, "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &full_index);
+        store::all(full, &full_index);
+
+        store::Store lazy;
+        intersection::Index lazy_index;
+        parse::input(lazy, budget, min_cost, cost_gcd, age_string, "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &lazy_index, nullptr, true);
+        store::all(lazy, &lazy_index);
+
+        store::Store streamed;
+        parse::stream(streamed, budget, min_cost, cost_gcd, age_string, "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv");
+
+        size_t targeted = 0;
+        for (const auto& targets : full.region_targets)
+        {
+            if (targets != std::array<double, intersection::TIMESLOTS>{}) { ++targeted; }
+        }
+        if (lazy.benefits != full.benefits or streamed.benefits != full.benefits or lazy.route_targets != full.route_targets
+            or lazy.region_features != full.region_features or lazy.population != full.population
+            or lazy.region_boxes.size() != targeted)
+        {
+            std::clog << "FAILED! The lazily parsed regions differ from all regions for the ages " << age_string << std::endl;
+            exit(-1);
+        }
+        std::clog << "    ages " << age_string << ": " << full.region_boxes.size() - targeted << " of "
+            << full.region_boxes.size() << " regions left out\n";
+    }
+    std::clog << "Lazy PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the regions and routes read from gzip files give exactly the same benefits as the GeoJSON
+    files, in the store and when streaming, and that a truncated gzip file is found to be damaged.
+*/
+void gzipped()
+{
+    std::string regions_path = "./test.regions.gz";
+    std::string routes_path = "./test.routes.gz";
+    std::string truncated_path = "./test.truncated.gz";
+    std::string regions_text;
+    for (const auto& paths : {std::make_pair(std::string{"./data/Population_1.geojson"}, regions_path),
+        std::make_pair(std::string{"./data/Route.geojson"}, routes_path)})
+    {
+        std::ifstream stream {paths.first, std::ios::binary};
+        std::string text {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        gzFile file = gzopen(paths.second.c_str(), "wb");
+        gzwrite(file, text.data(), static_cast<unsigned>(text.size()));
+        gzclose(file);
+        if (paths.first == "./data/Population_1.geojson") { regions_text = text; }
+    }
+
+    for (std::string age_string : {"1, 2, 5", "1, 2, 3, 4, 5, 6"})
+    {
+        store::Store text;
+        intersection::Index text_index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(text, budget, min_cost, cost_gcd, age_string, "10000000",
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &text_index);
+        store::all(text, &text_index);
+
+        store::Store gzip;
+        intersection::Index gzip_index;
+        double gzip_gcd {0.0};
+        double gzip_min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(gzip, budget, gzip_min_cost, gzip_gcd, age_string, "10000000",
+            regions_path, routes_path, "./data/active.csv", &gzip_index);
+        store::all(gzip, &gzip_index);
+
+        store::Store streamed;
+        parse::stream(streamed, budget, gzip_min_cost, gzip_gcd, age_string, "10000000",
+            regions_path, routes_path, "./data/active.csv");
+
+        if (gzip.benefits != text.benefits or gzip.points != text.points or gzip.population != text.population
+            or gzip.ordinals != text.ordinals or streamed.benefits != text.benefits
+            or gzip_gcd != cost_gcd or gzip_min_cost != min_cost)
+        {
+            std::clog << "FAILED! The gzip files differ from the GeoJSON files for the ages " << age_string << std::endl;
+            exit(-1);
+        }
+    }
+
+    {
+        std::ifstream stream {regions_path, std::ios::binary};
+        std::string bytes {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        std::ofstream truncated {truncated_path, std::ios::binary};
+        truncated.write(bytes.data(), bytes.size() / 2);
+    }
+    compressed::Reader reader {truncated_path};
+    std::string block;
+    size_t size = 0;
+    while (reader.next(block)) { size += block.size(); }
+    if (not reader.damaged() or size >= regions_text.size())
+    {
+        std::clog << "FAILED! A truncated gzip file is not found to be damaged" << std::endl;
+        exit(-1);
+    }
+    std::remove(regions_path.c_str());
+    std::remove(routes_path.c_str());
+    std::remove(truncated_path.c_str());
+    std::clog << "Gzipped PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the regions read from a zstd file give exactly the same benefits as the GeoJSON file, that a truncated
+    zstd file is found to be damaged, and that a missing zstd program is told apart. Skipped without the zstd program.
+*/
+void zstandard()
+{
+    if (std::system("zstd --version > /dev/null 2>&1") != 0)
+    {
+        std::clog << "Zstandard SKIPPED, the zstd program is missing\n";
+        std::clog << "***************************************************\n";
+        std::clog << std::endl;
+        return;
+    }
+
+    std::string regions_path = "./test.regions.zst";
+    std::string truncated_path = "./test.truncated.zst";
+    if (std::system(("zstd -qf -o " + regions_path + " ./data/Population_1.geojson").c_str()) != 0)
+    {
+        std::clog << "FAILED! The zstd program could not compress the regions" << std::endl;
+        exit(-1);
+    }
+
+    store::Store text;
+    store::Store zstd;
+    for (store::Store* store : {&text, &zstd})
+    {
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        intersection::Index index;
+        parse::input(*store, budget, min_cost, cost_gcd, "1, 2, 5", "10000000",
+            store == &text ? "./data/Population_1.geojson" : regions_path, "./data/Route.geojson", "./data/active.csv", &index);
+        store::all(*store, &index);
+    }
+    if (zstd.benefits != text.benefits or zstd.points != text.points or zstd.population != text.population)
+    {
+        std::clog << "FAILED! The zstd file differs from the GeoJSON file" << std::endl;
+        exit(-1);
+    }
+
+    {
+        std::ifstream stream {regions_path, std::ios::binary};
+        std::string bytes {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        std::ofstream truncated {truncated_path, std::ios::binary};
+        truncated.write(bytes.data(), bytes.size() / 2);
+    }
+    {
+        compressed::Reader reader {truncated_path};
+        std::string block;
+        while (reader.next(block)) {}
+        if (not reader.damaged() or reader.missing())
+        {
+            std::clog << "FAILED! A truncated zstd file is not found to be damaged" << std::endl;
+            exit(-1);
+        }
+    }
+
+#ifndef LIBZSTD
+    // without a path to search, the zstd program cannot be found
+    std::string path = std::getenv("PATH");
+    setenv("PATH", "", 1);
+    {
+        compressed::Reader reader {regions_path};
+        std::string block;
+        while (reader.next(block)) {}
+        if (not reader.missing())
+        {
+            std::clog << "FAILED! A missing zstd program is not told apart from a damaged file" << std::endl;
+            exit(-1);
+        }
+    }
+    setenv("PATH", path.c_str(), 1);
+#endif
+
+    std::remove(regions_path.c_str());
+    std::remove(truncated_path.c_str());
+    std::clog << "Zstandard PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that the server answers a stream of queries with exactly the allocations of single runs of the
+    program, also after reloading unchanged files, and answers invalid queries with errors.
+*/
+void served()
+{
+    std::vector<std::pair<std::string, std::string>> queries {{"1,2,5", "10000000"}, {"6", "5000000"},
+        {"1, 2, 3, 4, 5, 6", "30000000"}, {"1,2,5", "10000000"}};
+    std::stringstream in;
+    std::string expected;
+    for (size_t q = 0; q < queries.size(); ++q)
+    {
+        in << queries[q].first << "\n" << queries[q].second << "\n./data/active.csv\n";
+        if (q == 1) { in << "RELOAD\n"; }
+
+        store::Store store;
+        intersection::Index index;
+        double budget;
+        double cost_gcd {0.0};
+        double min_cost {std::numeric_limits<double>::infinity()};
+        parse::input(store, budget, min_cost, cost_gcd, queries[q].first, queries[q].second,
+            "./data/Population_1.geojson", "./data/Route.geojson", "./data/active.csv", &index, nullptr, true);
+        store::all(store, &index);
+        std::vector<std::unique_ptr<intersection::Route>> routes;
+        store::items(store, routes);
+        std::map<int, int> allocation;
+        knapsack::optimize(routes, budget, min_cost, cost_gcd, allocation);
+        for (const auto& iter : allocation) { expected += std::to_string(iter.first) + "," + std::to_string(iter.second) + "\n"; }
+        expected += "END\n";
+    }
+    in << "1,2,8\n10000000\n./data/active.csv\n1,2,5\n10000000\n./data/missing.csv\n";
+    expected += "ERROR,Age groups 1,2,8 are not valid\nEND\nERROR,Could not find the activity file ./data/missing.csv\nEND\n";
+    const std::string invalid_path = "./test.active.csv";
+    std::ofstream {invalid_path} << "a,b\nx,foo,bar,baz";
+    in << "1,2,5\n10000000\n" << invalid_path << "\n";
+    expected += "ERROR,Active factor foo could not be parsed: stod\nEND\n";
+
+    std::stringstream out;
+    auto latencies = server::serve(in, out, "./data/Population_1.geojson", "./data/Route.geojson");
+    std::remove(invalid_path.c_str());
+    if (out.str() != expected or latencies.size() != queries.size() + 3)
+    {
+        std::clog << "FAILED! The server answered\n" << out.str() << "instead of\n" << expected << std::endl;
+        exit(-1);
+    }
+    std::clog << "Served PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Represents an input stream buffer of several pieces of text, which calls a function before handing out
+    each piece, so that a test can change files while a server reads its queries.
+*/
+class Script : public std::streambuf
+{
+public:
+    void add(const std::function<void()>& before, const std::string& text)
+    {
+        pieces.emplace_back(before, text);
+    }
+
+protected:
+    int_type underflow() override
+    {
+        if (gptr() < egptr()) { return traits_type::to_int_type(*gptr()); }
+        if (next == pieces.size()) { return traits_type::eof(); }
+
+        auto& piece = pieces[next++];
+        if (piece.first) { piece.first(); }
+        char* text = &piece.second[0];
+        setg(text, text, text + piece.second.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    std::vector<std::pair<std::function<void()>, std::string>> pieces;
+    size_t next = 0;
+};
+
+/**
+    Computes the answer of the server to a query by a single run of the program.
+
+    @param age_string the target ages of the query
+    @param budget_string the budget of the query
+    @param routes_path path to the file with the routes
+    @return the lines of the allocation followed by the line END
+*/
+std::string answered(const std::string& age_string, const std::string& budget_string, const std::string& routes_path)
+{
+    store::Store store;
+    intersection::Index index;
+    double budget;
+    double cost_gcd {0.0};
+    double min_cost {std::numeric_limits<double>::infinity()};
+    parse::input(store, budget, min_cost, cost_gcd, age_string, budget_string,
+        "./data/Population_1.geojson", routes_path, "./data/active.csv", &index);
+    store::all(store, &index);
+    std::vector<std::unique_ptr<intersection::Route>> routes;
+    store::items(store, routes);
+    std::map<int, int> allocation;
+    knapsack::optimize(routes, budget, min_cost, cost_gcd, allocation);
+
+    std::string answer;
+    for (const auto& iter : allocation) { answer += std::to_string(iter.first) + "," + std::to_string(iter.second) + "\n"; }
+    return answer + "END\n";
+}
+
+/**
+    Checks that the server answers from changed files once it has reloaded them, and that it keeps answering
+    from its old data when the reloaded files are damaged. The second RELOAD of each pair waits for the first.
+*/
+void reloaded()
+{
+    const std::string routes_path = "./test.routes.geojson";
+    std::ifstream stream {"./data/Route.geojson", std::ios::binary};
+    const std::string text {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    std::string changed = text;
+    for (size_t pos; (pos = changed.find("\"Cost\": 1200000")) != std::string::npos;)
+    {
+        changed.replace(pos, 16, "\"Cost\": 300000");
+    }
+    auto write = [&routes_path](const std::string& contents)
+    {
+        std::ofstream file {routes_path, std::ios::binary | std::ios::trunc};
+        file << contents;
+    };
+    write(text);
+
+    const std::string query = "1,2,5\n10000000\n./data/active.csv\n";
+    const std::string before = answered("1,2,5", "10000000", routes_path);
+    write(changed);
+    const std::string after = answered("1,2,5", "10000000", routes_path);
+    write(text);
+    if (before == after)
+    {
+        std::clog << "FAILED! The changed routes give the same allocation" << std::endl;
+        exit(-1);
+    }
+
+    Script script;
+    script.add(nullptr, query);
+    script.add([&] { write(changed); }, "RELOAD\nRELOAD\n" + query);
+    script.add([&] { write(changed.substr(0, changed.size() / 2)); }, "RELOAD\nRELOAD\n" + query);
+    script.add([&] { write(""); }, "RELOAD\nRELOAD\n" + query);
+    script.add([&] { write("{\n\"type\": \"FeatureCollection\",\n\"features\": [\n]\n}\n"); }, "RELOAD\nRELOAD\n" + query);
+    std::istream in {&script};
+    std::stringstream out;
+    server::serve(in, out, "./data/Population_1.geojson", routes_path);
+
+    std::remove(routes_path.c_str());
+    if (out.str() != before + after + after + after + after)
+    {
+        std::clog << "FAILED! The reloading server answered\n" << out.str() << "instead of\n" << before + after + after + after + after << std::endl;
+        exit(-1);
+    }
+    std::clog << "Reloaded PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
+/**
+    Checks that a batch of queries, answered in groups on several threads, gets exactly the answers
+    of the same queries served one by one, in the order of the queries.
+*/
+void batched()
+{
+    std::string queries;
+    const std::vector<std::string> age_strings {"1,2,5", "6", "5, 2, 1", "1,2,3,4,5,6", "3,3"};
+    for (int q = 0; q < 40; ++q)
+    {
+        queries += age_strings[q % age_strings.size()] + "\n" + std::to_string(500000 * (1 + q * 7 % 60)) + "\n./data/active.csv\n";
+    }
+    queries += "1,0\n10000000\n./data/active.csv\n1,2,5\n10000\n./data/active.csv\n";
+    const std::string invalid_path = "./test.batch.csv";
+    std::ofstream {invalid_path} << "a,b\nx,foo,bar,baz";
+    queries += "1,2,5\n10000000\n" + invalid_path + "\n6\n5000000\n" + invalid_path + "\n";
+
+    std::stringstream served_in {queries};
+    std::stringstream served_out;
+    server::serve(served_in, served_out, "./data/Population_1.geojson", "./data/Route.geojson");
+
+    auto data = server::load(cache::Key{}, "./data/Population_1.geojson", "./data/Route.geojson");
+    for (size_t threads : {1, 3})
+    {
+        pool::Pool workers {threads};
+        std::stringstream batch_in {queries};
+        std::stringstream batch_out;
+        size_t groups = server::batch(batch_in, batch_out, *data, &workers);
+        if (batch_out.str() != served_out.str() or groups != 4
+            or served_out.str().find("ERROR,Active factor foo could not be parsed") == std::string::npos)
+        {
+            std::clog << "FAILED! The batch on " << threads << " threads answered\n" << batch_out.str()
+                << "instead of\n" << served_out.str() << std::endl;
+            exit(-1);
+        }
+    }
+    std::remove(invalid_path.c_str());
+    std::clog << "Batched PASSED!\n";
+    std::clog << "***************************************************\n";
+    std::clog << std::endl;
+}
+
 int main()
 {
     clock_t total_start = clock();
@@ -137,6 +1390,26 @@ int main()
     correct_value = 0;
     run(age_string, budget_string, regions_path, routes_path, active_path, correct_value);
 
+    frontier();
+    ties();
+    threads();
+    concave();
+    whatif();
+    edges();
+    cached();
+    ages();
+    lines();
+    chunked();
+    binary();
+    doubles();
+    streamed();
+    lazy();
+    gzipped();
+    zstandard();
+    served();
+    reloaded();
+    batched();
+
     std::clog << "Total runtime of all tests is " << since(total_start) << "ms" << std::endl;
     return 0;
 }
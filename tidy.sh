@@ -1,4 +1,4 @@
 #!/bin/bash
 
-rm example.out main test busproject.zip 2>/dev/null
+rm example.out main test bench convert busproject.zip 2>/dev/null
 rm -rf busproject 2>/dev/null